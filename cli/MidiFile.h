@@ -0,0 +1,249 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "../dsp/Synth.h"
+
+/*
+  Reads a Standard MIDI File (format 0 or 1) and turns it into a list of
+  MidiEvents for Synth::render().
+
+  The events from all the tracks are merged and sorted by time. The times
+  in the file are in ticks, which get converted to sample positions using
+  the tempo changes from the file, so the result can be rendered directly.
+  SysEx and meta events other than the tempo are skipped.
+
+  `length` receives the sample position of the end of the song, which is
+  the last End of Track event.
+ */
+class MidiFile
+{
+public:
+    bool read(const char* filename, double sampleRate, std::vector<MidiEvent>& events, int& length)
+    {
+        FILE* f = fopen(filename, "rb");
+        if (!f) {
+            printf("Error: could not open MIDI file %s.\n", filename);
+            return false;
+        }
+        fseek(f, 0, SEEK_END);
+        long size = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        data.resize(size > 0 ? size_t(size) : 0);
+        size_t bytesRead = fread(data.data(), 1, data.size(), f);
+        fclose(f);
+
+        if (bytesRead != data.size() || !parse()) {
+            printf("Error: %s is not a valid MIDI file.\n", filename);
+            return false;
+        }
+
+        // Tempo changes and notes at the same tick stay in file order, and
+        // the tempo track comes first, so a tempo change applies to the
+        // notes that start at the same time.
+        std::stable_sort(timeline.begin(), timeline.end(),
+                         [](const TimedEvent& a, const TimedEvent& b) { return a.tick < b.tick; });
+
+        events.clear();
+        double seconds = 0.0;
+        uint64_t previousTick = 0;
+        double secondsPerTick = secondsPerTickAt(500000);  // 120 BPM
+
+        for (const TimedEvent& event : timeline) {
+            seconds += double(event.tick - previousTick) * secondsPerTick;
+            previousTick = event.tick;
+
+            if (event.tempo > 0) {
+                secondsPerTick = secondsPerTickAt(event.tempo);
+            } else {
+                MidiEvent midi;
+                midi.position = int(seconds * sampleRate + 0.5);
+                std::copy(event.data, event.data + 3, midi.data);
+                events.push_back(midi);
+            }
+        }
+
+        seconds += double(std::max(endTick, previousTick) - previousTick) * secondsPerTick;
+        length = int(seconds * sampleRate + 0.5);
+        return true;
+    }
+
+private:
+    struct TimedEvent
+    {
+        uint64_t tick;
+        uint32_t tempo;     // microseconds per quarter note, or 0 if this is MIDI
+        uint8_t data[3];
+    };
+
+    double secondsPerTickAt(uint32_t tempo) const
+    {
+        // With SMPTE timing the division is in ticks per second and the
+        // tempo does not matter.
+        if (ticksPerSecond > 0.0) {
+            return 1.0 / ticksPerSecond;
+        }
+        return double(tempo) * 1e-6 / double(ticksPerQuarter);
+    }
+
+    bool parse()
+    {
+        pos = 0;
+        timeline.clear();
+        endTick = 0;
+
+        if (!expectTag("MThd") || read32() != 6) {
+            return false;
+        }
+        const int format = read16();
+        const int trackCount = read16();
+        const int division = read16();
+        if (format > 1 || division == 0) {
+            return false;
+        }
+
+        if (division & 0x8000) {
+            // Frames per second as a negative number, ticks per frame.
+            const int fps = 256 - (division >> 8);
+            ticksPerSecond = double(fps == 29 ? 29.97 : fps) * double(division & 0xFF);
+        } else {
+            ticksPerSecond = 0.0;
+            ticksPerQuarter = division;
+        }
+
+        for (int track = 0; track < trackCount; ++track) {
+            if (!expectTag("MTrk")) {
+                return false;
+            }
+            const size_t trackLength = read32();
+            const size_t trackEnd = pos + trackLength;
+            if (trackEnd > data.size() || !parseTrack(trackEnd)) {
+                return false;
+            }
+            pos = trackEnd;
+        }
+        return true;
+    }
+
+    bool parseTrack(size_t trackEnd)
+    {
+        uint64_t tick = 0;
+        uint8_t runningStatus = 0;
+
+        while (pos < trackEnd) {
+            tick += readVariableLength();
+            if (pos >= trackEnd) {
+                return false;
+            }
+
+            uint8_t status = data[pos];
+            if (status < 0x80) {
+                // Running status: the data byte belongs to the same kind of
+                // message as the previous one.
+                if (runningStatus == 0) {
+                    return false;
+                }
+                status = runningStatus;
+            } else {
+                pos += 1;
+            }
+
+            // Meta and SysEx events cancel running status, so a data byte
+            // after them doesn't belong to the previous channel message.
+            if (status == 0xFF) {
+                runningStatus = 0;
+                if (pos >= trackEnd) {
+                    return false;
+                }
+                const uint8_t type = data[pos++];
+                const size_t length = readVariableLength();
+                if (pos + length > trackEnd) {
+                    return false;
+                }
+                if (type == 0x51 && length == 3) {
+                    TimedEvent event = { tick, 0, { 0, 0, 0 } };
+                    event.tempo = (uint32_t(data[pos]) << 16) | (uint32_t(data[pos + 1]) << 8) | data[pos + 2];
+                    if (event.tempo > 0) {
+                        timeline.push_back(event);
+                    }
+                } else if (type == 0x2F) {
+                    endTick = std::max(endTick, tick);
+                }
+                pos += length;
+            } else if (status == 0xF0 || status == 0xF7) {
+                const size_t length = readVariableLength();
+                pos += length;
+                runningStatus = 0;
+            } else if (status >= 0x80 && status < 0xF0) {
+                const int dataBytes = ((status & 0xF0) == 0xC0 || (status & 0xF0) == 0xD0) ? 1 : 2;
+                if (pos + dataBytes > trackEnd) {
+                    return false;
+                }
+                TimedEvent event = { tick, 0, { status, data[pos], 0 } };
+                if (dataBytes == 2) {
+                    event.data[2] = data[pos + 1];
+                }
+                timeline.push_back(event);
+                pos += dataBytes;
+                runningStatus = status;
+            } else {
+                return false;  // system common messages don't belong in a file
+            }
+        }
+        endTick = std::max(endTick, tick);
+        return pos == trackEnd;
+    }
+
+    bool expectTag(const char* tag)
+    {
+        if (pos + 8 > data.size() || !std::equal(tag, tag + 4, data.begin() + pos)) {
+            return false;
+        }
+        pos += 4;
+        return true;
+    }
+
+    uint32_t read32()
+    {
+        uint32_t value = 0;
+        for (int i = 0; i < 4 && pos < data.size(); ++i) {
+            value = (value << 8) | data[pos++];
+        }
+        return value;
+    }
+
+    int read16()
+    {
+        int value = 0;
+        for (int i = 0; i < 2 && pos < data.size(); ++i) {
+            value = (value << 8) | data[pos++];
+        }
+        return value;
+    }
+
+    // Numbers of up to 4 bytes with 7 bits each. The high bit means that
+    // there are more bytes to come.
+    uint32_t readVariableLength()
+    {
+        uint32_t value = 0;
+        for (int i = 0; i < 4 && pos < data.size(); ++i) {
+            const uint8_t byte = data[pos++];
+            value = (value << 7) | (byte & 0x7F);
+            if ((byte & 0x80) == 0) {
+                break;
+            }
+        }
+        return value;
+    }
+
+    std::vector<uint8_t> data;
+    size_t pos = 0;
+
+    std::vector<TimedEvent> timeline;
+    uint64_t endTick = 0;
+    int ticksPerQuarter = 480;
+    double ticksPerSecond = 0.0;
+};
@@ -0,0 +1,501 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define WAVWRITER_HAS_MMAP 1
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+enum class SampleFormat
+{
+    int16,    // 16-bit PCM
+    int24,    // 24-bit PCM
+    float32,  // 32-bit IEEE float
+};
+
+struct WavFormat
+{
+    double sampleRate = 48000.0;
+    int channels = 1;
+    SampleFormat sampleFormat = SampleFormat::int16;
+
+    // Add triangular (TPDF) dither when converting to 16 or 24 bits.
+    bool dither = false;
+
+    // Reserve room in the header so that the file can become an RF64 file
+    // if the audio data grows beyond 4 GB. Files that stay smaller than
+    // that are regular WAV files with an extra JUNK chunk.
+    bool rf64 = false;
+
+    // Make the file its full size up front and map it into memory, so that
+    // the samples are converted straight into the file's pages instead of
+    // going through a buffer and fwrite(). This needs the number of frames
+    // to be known when the file is opened. Where mmap() is not available,
+    // or when it fails, the file is written the normal way.
+    bool memoryMap = false;
+};
+
+/*
+  Writes a WAV file while it is being rendered.
+
+  Samples passed to write() are converted and collected in a buffer, which
+  is written to disk whenever it fills up. The lengths in the header aren't
+  known until the end, so open() writes zeros there and close() goes back
+  and fills them in. The amount of memory used is always the same, no matter
+  how long the file is.
+
+  With `writeInBackground` there are two buffers. While a separate thread
+  writes one of them to disk, the renderer fills up the other one, so disk
+  I/O and synthesis happen at the same time.
+
+  A memory-mapped file doesn't need either of these. The operating system
+  writes the dirty pages to disk by itself, which is already in the
+  background, and there is no copy from the buffer to the file.
+ */
+class WavWriter
+{
+public:
+    // Number of sample frames that are collected before writing to disk.
+    static constexpr int bufferFrames = 32768;
+
+    ~WavWriter()
+    {
+        close();
+    }
+
+    /*
+      Creates the file. `frameCount` is how many frames will be written, or
+      0 if it isn't known yet. It's only used for memory mapping.
+     */
+    bool open(const char* filename, const WavFormat& format_, bool writeInBackground,
+              uint64_t frameCount = 0)
+    {
+        format = format_;
+        switch (format.sampleFormat) {
+            case SampleFormat::int16:   bytesPerSample = 2; break;
+            case SampleFormat::int24:   bytesPerSample = 3; break;
+            case SampleFormat::float32: bytesPerSample = 4; break;
+        }
+        frameSize = bytesPerSample * format.channels;
+
+        // A shared mapping must be able to read the file as well.
+        file = fopen(filename, format.memoryMap ? "wb+" : "wb");
+        if (!file) {
+            printf("Error: could not open %s for writing.\n", filename);
+            return false;
+        }
+
+        dataLength = 0;
+        failed = false;
+        // Every channel has its own dither generator. Then the dither only
+        // depends on the sample position, not on how many frames are passed
+        // to each write().
+        ditherSeeds.resize(format.channels);
+        for (int channel = 0; channel < format.channels; ++channel) {
+            ditherSeeds[channel] = 22222u + uint32_t(channel) * 2654435761u;
+        }
+
+        std::vector<uint8_t> header = makeHeader();
+        fwrite(header.data(), 1, header.size(), file);
+
+        current = 0;
+        fill = 0;
+        if (format.memoryMap && frameCount > 0 && mapFile(frameCount)) {
+            return true;
+        }
+
+        buffers[0].resize(size_t(bufferFrames) * frameSize);
+
+        background = writeInBackground;
+        if (background) {
+            buffers[1].resize(size_t(bufferFrames) * frameSize);
+            pending = -1;
+            quit = false;
+            thread = std::thread([this] { writerThread(); });
+        }
+        return true;
+    }
+
+    /*
+      Writes `frameCount` samples for every channel. The channels are given
+      as separate arrays and get interleaved here. To write a mono signal
+      to several channels, simply pass the same pointer more than once.
+     */
+    void write(const float* const* channelData, int frameCount)
+    {
+        if (mapped) {
+            writeMapped(channelData, frameCount);
+            return;
+        }
+
+        int offset = 0;
+        while (offset < frameCount) {
+            int count = std::min(frameCount - offset, bufferFrames - fill);
+            uint8_t* buffer = buffers[current].data() + size_t(fill) * frameSize;
+
+            for (int channel = 0; channel < format.channels; ++channel) {
+                convert(channelData[channel] + offset, count, buffer + channel * bytesPerSample,
+                        ditherSeeds[channel]);
+            }
+
+            fill += count;
+            offset += count;
+
+            if (fill == bufferFrames) {
+                flush();
+            }
+        }
+    }
+
+    /*
+      Writes any remaining samples, fills in the header, and closes the file.
+      Returns false if anything went wrong while writing.
+     */
+    bool close()
+    {
+        if (!file) {
+            return false;
+        }
+
+        unmapFile();
+        flush();
+
+        if (background) {
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                quit = true;
+            }
+            condition.notify_all();
+            thread.join();
+        }
+
+        if (!fitsIn32Bits() && !format.rf64) {
+            printf("Error: the WAV file is larger than 4 GB, use RF64 instead.\n");
+            failed = true;
+        }
+
+        // RIFF chunks must have an even length. An odd-sized data chunk,
+        // such as 24-bit mono with an odd number of frames, gets a zero pad
+        // byte after it that is not part of the data.
+        if (padLength() > 0 && (fseek(file, 0, SEEK_END) != 0 || fputc(0, file) == EOF)) {
+            failed = true;
+        }
+
+        std::vector<uint8_t> header = makeHeader();
+        fseek(file, 0, SEEK_SET);
+        fwrite(header.data(), 1, header.size(), file);
+
+        if (fclose(file) != 0) {
+            failed = true;
+        }
+        file = nullptr;
+
+        if (failed) {
+            printf("Error: could not write the WAV file.\n");
+        }
+        return !failed;
+    }
+
+private:
+    /*
+      Converts the samples for one channel and stores them into every
+      `frameSize` bytes of the output buffer.
+     */
+    void convert(const float* samples, int sampleCount, uint8_t* output, uint32_t& ditherSeed)
+    {
+        switch (format.sampleFormat) {
+            case SampleFormat::int16:
+                for (int i = 0; i < sampleCount; ++i, output += frameSize) {
+                    int32_t value = quantize(samples[i], 32767.0f, ditherSeed);
+                    output[0] = uint8_t(value);
+                    output[1] = uint8_t(value >> 8);
+                }
+                break;
+
+            case SampleFormat::int24:
+                for (int i = 0; i < sampleCount; ++i, output += frameSize) {
+                    int32_t value = quantize(samples[i], 8388607.0f, ditherSeed);
+                    output[0] = uint8_t(value);
+                    output[1] = uint8_t(value >> 8);
+                    output[2] = uint8_t(value >> 16);
+                }
+                break;
+
+            case SampleFormat::float32:
+                for (int i = 0; i < sampleCount; ++i, output += frameSize) {
+                    std::memcpy(output, &samples[i], 4);
+                }
+                break;
+        }
+    }
+
+    int32_t quantize(float x, float scale, uint32_t& ditherSeed)
+    {
+        x = std::min(std::max(x, -1.0f), 1.0f) * scale;
+        if (!format.dither) {
+            return static_cast<int32_t>(x);
+        }
+
+        // The difference of two uniform random numbers has a triangular
+        // distribution between -1 and +1 LSB.
+        x += randomFloat(ditherSeed) - randomFloat(ditherSeed);
+        x = std::floor(x + 0.5f);
+        return static_cast<int32_t>(std::min(std::max(x, -scale - 1.0f), scale));
+    }
+
+    static float randomFloat(uint32_t& ditherSeed)
+    {
+        ditherSeed = ditherSeed * 196314165 + 907633515;
+        return float(ditherSeed >> 8) / 16777216.0f;
+    }
+
+    bool fitsIn32Bits() const
+    {
+        return dataLength + padLength() + headerSize() - 8 <= 0xFFFFFFFFull;
+    }
+
+    uint64_t padLength() const
+    {
+        return dataLength & 1;
+    }
+
+    size_t headerSize() const
+    {
+        size_t fmtSize = useExtensible() ? 40 : 16;
+        size_t factSize = hasFactChunk() ? 12 : 0;
+        return 12 + (format.rf64 ? 36 : 0) + 8 + fmtSize + factSize + 8;
+    }
+
+    bool hasFactChunk() const
+    {
+        // Every format other than PCM needs a fact chunk with the length in
+        // frames. Most readers don't care, but the strict ones do.
+        return format.sampleFormat == SampleFormat::float32;
+    }
+
+    bool useExtensible() const
+    {
+        // WAVE_FORMAT_EXTENSIBLE is needed to say which speaker each channel
+        // belongs to when there are more than two of them.
+        return format.channels > 2;
+    }
+
+    std::vector<uint8_t> makeHeader() const
+    {
+        std::vector<uint8_t> header;
+        auto tag = [&](const char* id) { header.insert(header.end(), id, id + 4); };
+        auto u16 = [&](uint32_t x) { for (int i = 0; i < 2; ++i) header.push_back(uint8_t(x >> (8 * i))); };
+        auto u32 = [&](uint32_t x) { for (int i = 0; i < 4; ++i) header.push_back(uint8_t(x >> (8 * i))); };
+        auto u64 = [&](uint64_t x) { for (int i = 0; i < 8; ++i) header.push_back(uint8_t(x >> (8 * i))); };
+
+        const bool isRF64 = format.rf64 && !fitsIn32Bits();
+        const uint64_t riffLength = headerSize() - 8 + dataLength + padLength();
+        const uint16_t formatTag = (format.sampleFormat == SampleFormat::float32) ? 3 : 1;
+        const uint32_t srate = static_cast<uint32_t>(format.sampleRate);
+
+        tag(isRF64 ? "RF64" : "RIFF");
+        u32(isRF64 ? 0xFFFFFFFF : uint32_t(riffLength));
+        tag("WAVE");
+
+        // The ds64 chunk holds the 64-bit lengths for RF64 files. As long as
+        // the file is small enough, this space is taken up by a JUNK chunk.
+        if (format.rf64) {
+            tag(isRF64 ? "ds64" : "JUNK");
+            u32(28);
+            u64(isRF64 ? riffLength : 0);
+            u64(isRF64 ? dataLength : 0);
+            u64(isRF64 ? dataLength / frameSize : 0);
+            u32(0);  // no table entries
+        }
+
+        tag("fmt ");
+        u32(useExtensible() ? 40 : 16);
+        u16(useExtensible() ? 0xFFFE : formatTag);
+        u16(uint32_t(format.channels));
+        u32(srate);
+        u32(srate * uint32_t(frameSize));
+        u16(uint32_t(frameSize));
+        u16(uint32_t(bytesPerSample * 8));
+        if (useExtensible()) {
+            // Size of the extension, valid bits per sample, and which
+            // speakers are used. The sub-format GUID starts with the format
+            // tag, followed by the same 14 bytes for both PCM and float.
+            u16(22);
+            u16(uint32_t(bytesPerSample * 8));
+            u32((1u << std::min(format.channels, 18)) - 1);
+            u16(formatTag);
+            const uint8_t guid[14] = { 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80,
+                                       0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71 };
+            header.insert(header.end(), guid, guid + 14);
+        }
+
+        // In an RF64 file the real frame count is in the ds64 chunk.
+        if (hasFactChunk()) {
+            tag("fact");
+            u32(4);
+            u32(isRF64 ? 0xFFFFFFFF : uint32_t(dataLength / frameSize));
+        }
+
+        tag("data");
+        u32(isRF64 ? 0xFFFFFFFF : uint32_t(dataLength));
+        return header;
+    }
+
+    /*
+      Grows the file to its final size and maps it. The header was already
+      written with fwrite(), so that has to be flushed out of the stdio
+      buffer first, otherwise fclose() would write it over the mapping.
+     */
+    bool mapFile(uint64_t frameCount)
+    {
+        #ifdef WAVWRITER_HAS_MMAP
+        const uint64_t length = headerSize() + frameCount * frameSize;
+        if (uint64_t(size_t(length)) != length || fflush(file) != 0) {
+            return false;
+        }
+
+        const int fd = fileno(file);
+        if (ftruncate(fd, off_t(length)) != 0) {
+            return false;
+        }
+
+        void* address = mmap(nullptr, size_t(length), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (address == MAP_FAILED) {
+            ftruncate(fd, off_t(headerSize()));
+            return false;
+        }
+
+        mapped = static_cast<uint8_t*>(address);
+        mappedLength = size_t(length);
+        background = false;
+        return true;
+        #else
+        (void)frameCount;
+        return false;
+        #endif
+    }
+
+    void writeMapped(const float* const* channelData, int frameCount)
+    {
+        const uint64_t room = (mappedLength - headerSize() - dataLength) / frameSize;
+        if (uint64_t(frameCount) > room) {
+            failed = true;  // more frames than open() was told about
+            frameCount = int(room);
+        }
+
+        uint8_t* frames = mapped + headerSize() + dataLength;
+        for (int channel = 0; channel < format.channels; ++channel) {
+            convert(channelData[channel], frameCount, frames + channel * bytesPerSample,
+                    ditherSeeds[channel]);
+        }
+        dataLength += uint64_t(frameCount) * frameSize;
+    }
+
+    // If fewer frames were written than expected, the file gets cut off
+    // after the last one.
+    void unmapFile()
+    {
+        #ifdef WAVWRITER_HAS_MMAP
+        if (!mapped) {
+            return;
+        }
+        if (munmap(mapped, mappedLength) != 0) {
+            failed = true;
+        }
+        const uint64_t length = headerSize() + dataLength;
+        if (length < mappedLength && ftruncate(fileno(file), off_t(length)) != 0) {
+            failed = true;
+        }
+        mapped = nullptr;
+        mappedLength = 0;
+        #endif
+    }
+
+    void flush()
+    {
+        if (fill == 0) {
+            return;
+        }
+
+        if (!background) {
+            writeToDisk(buffers[current].data(), fill);
+            fill = 0;
+            return;
+        }
+
+        // Wait until the writer thread is done with the other buffer, then
+        // give it this one and continue filling the other one.
+        std::unique_lock<std::mutex> guard(lock);
+        condition.wait(guard, [this] { return pending < 0; });
+        pending = current;
+        pendingCount = fill;
+        guard.unlock();
+        condition.notify_all();
+
+        current ^= 1;
+        fill = 0;
+    }
+
+    void writeToDisk(const uint8_t* frames, int frameCount)
+    {
+        size_t byteCount = size_t(frameCount) * frameSize;
+        if (fwrite(frames, 1, byteCount, file) != byteCount) {
+            failed = true;
+        }
+        dataLength += byteCount;
+    }
+
+    void writerThread()
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        while (true) {
+            condition.wait(guard, [this] { return pending >= 0 || quit; });
+            if (pending < 0) {
+                break;  // quit and nothing left to write
+            }
+
+            const uint8_t* frames = buffers[pending].data();
+            int frameCount = pendingCount;
+            guard.unlock();
+            writeToDisk(frames, frameCount);
+            guard.lock();
+
+            pending = -1;
+            condition.notify_all();
+        }
+    }
+
+    WavFormat format;
+    int bytesPerSample = 2;
+    int frameSize = 2;
+
+    FILE* file = nullptr;
+    uint64_t dataLength = 0;
+    bool failed = false;
+    std::vector<uint32_t> ditherSeeds;
+
+    uint8_t* mapped = nullptr;
+    size_t mappedLength = 0;
+
+    std::vector<uint8_t> buffers[2];
+    int current = 0;  // the buffer that write() is filling
+    int fill = 0;     // how many frames are in that buffer
+
+    bool background = false;
+    std::thread thread;
+    std::mutex lock;
+    std::condition_variable condition;
+    int pending = -1;      // buffer waiting to be written by the thread
+    int pendingCount = 0;
+    bool quit = false;
+};
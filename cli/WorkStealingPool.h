@@ -0,0 +1,157 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+  Runs a batch of independent tasks on several threads.
+
+  Each thread has its own queue of tasks. A thread takes work from the back
+  of its own queue, and when that is empty it steals from the front of the
+  queue of another thread. Tasks that take very different amounts of time,
+  such as renders of different lengths, still keep all cores busy until the
+  very end.
+
+  The threads are started once, by the constructor, and wait on a condition
+  variable between batches. A chunked render calls run() for every round of
+  chunks, so starting new threads each time would add up. The tasks are
+  only handed out at the start of run(), so once every queue is empty there
+  is nothing left to do in this batch and the threads go back to waiting.
+  The thread that calls run() works on the batch too.
+ */
+class WorkStealingPool
+{
+public:
+    explicit WorkStealingPool(int numThreads) : queues(numThreads > 0 ? numThreads : 1)
+    {
+        for (int t = 1; t < int(queues.size()); ++t) {
+            threads.emplace_back([this, t] { waitForWork(t); });
+        }
+    }
+
+    ~WorkStealingPool()
+    {
+        {
+            std::lock_guard<std::mutex> guard(batchLock);
+            stopping = true;
+        }
+        wakeUp.notify_all();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    /*
+      Calls task(i) for every i in [0, taskCount) and returns when they have
+      all finished. The tasks may run in any order and on any thread. This
+      must not be called from inside a task.
+     */
+    void run(int taskCount, const std::function<void(int)>& task)
+    {
+        const int numThreads = int(queues.size());
+        for (int i = 0; i < taskCount; ++i) {
+            Queue& queue = queues[i % numThreads];
+            std::lock_guard<std::mutex> guard(queue.lock);
+            queue.tasks.push_back(i);
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(batchLock);
+            currentTask = &task;
+            busyThreads = numThreads - 1;
+            batch += 1;
+        }
+        wakeUp.notify_all();
+
+        work(0, task);
+
+        std::unique_lock<std::mutex> guard(batchLock);
+        finished.wait(guard, [this] { return busyThreads == 0; });
+        currentTask = nullptr;
+    }
+
+private:
+    struct Queue
+    {
+        std::mutex lock;
+        std::deque<int> tasks;
+    };
+
+    void work(int self, const std::function<void(int)>& task)
+    {
+        int index;
+        while (pop(self, index) || steal(self, index)) {
+            task(index);
+        }
+    }
+
+    bool pop(int self, int& index)
+    {
+        Queue& queue = queues[self];
+        std::lock_guard<std::mutex> guard(queue.lock);
+        if (queue.tasks.empty()) {
+            return false;
+        }
+        index = queue.tasks.back();
+        queue.tasks.pop_back();
+        return true;
+    }
+
+    bool steal(int self, int& index)
+    {
+        const int numThreads = int(queues.size());
+        for (int offset = 1; offset < numThreads; ++offset) {
+            Queue& victim = queues[(self + offset) % numThreads];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (!victim.tasks.empty()) {
+                index = victim.tasks.front();
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // The loop of every thread except the one that calls run().
+    void waitForWork(int self)
+    {
+        uint64_t lastBatch = 0;
+        for (;;) {
+            const std::function<void(int)>* task;
+            {
+                std::unique_lock<std::mutex> guard(batchLock);
+                wakeUp.wait(guard, [&] { return stopping || batch != lastBatch; });
+                if (stopping) {
+                    return;
+                }
+                lastBatch = batch;
+                task = currentTask;
+            }
+
+            work(self, *task);
+
+            std::lock_guard<std::mutex> guard(batchLock);
+            if (--busyThreads == 0) {
+                finished.notify_one();
+            }
+        }
+    }
+
+    std::vector<Queue> queues;
+
+    std::mutex batchLock;
+    std::condition_variable wakeUp;    // a new batch, or the pool is stopping
+    std::condition_variable finished;  // every thread is done with the batch
+    const std::function<void(int)>* currentTask = nullptr;
+    uint64_t batch = 0;
+    int busyThreads = 0;
+    bool stopping = false;
+
+    // Declared last, so that everything above exists before they start.
+    std::vector<std::thread> threads;
+};
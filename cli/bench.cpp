@@ -0,0 +1,984 @@
+/*
+
+  Benchmarks for the synthesis kernels.
+
+  Compile and run this on macOS:
+  $ clang -std=c++11 -lstdc++ -O2 -Wall -Wextra bench.cpp ../dsp/Envelope.cpp ../dsp/Modulation.cpp ../dsp/Noise.cpp ../dsp/Oversampler.cpp ../dsp/PitchTable.cpp ../dsp/SafetyLimiter.cpp ../dsp/SineKernel.cpp ../dsp/Synth.cpp ../dsp/Wavetable.cpp -o bench
+  $ ./bench
+
+  Compile and run this on Linux:
+  $ g++ -std=c++11 -O2 -Wall -Wextra bench.cpp ../dsp/Envelope.cpp ../dsp/Modulation.cpp ../dsp/Noise.cpp ../dsp/Oversampler.cpp ../dsp/PitchTable.cpp ../dsp/SafetyLimiter.cpp ../dsp/SineKernel.cpp ../dsp/Synth.cpp ../dsp/Wavetable.cpp -o bench
+  $ ./bench
+
+  For every kernel this measures the per-sample version from the recipes
+  ("scalar") against the block version from the dsp folder ("block"), at
+  block sizes from 32 to 1024 samples. The results are printed as JSON:
+
+      { "sineKernel": "avx2", "results": [
+        { "kernel": "sine", "path": "block", "blockSize": 64,
+          "sampleRate": 48000, "nsPerSample": 0.41, "voicesPerCore": 50813 }, ... ] }
+
+  `voicesPerCore` is how many copies of the kernel a single core could run
+  in real time at that sample rate, ignoring everything else a synth does.
+
+  Options:
+    -o <file.json>  write the results to a file instead of the terminal
+    -t <ms>         how long to run each measurement (default is 20 ms)
+    -c <file.txt>   check the output of the kernels against a reference
+    -r <file.txt>   write a new reference for -c
+
+  Making a kernel faster should not change what it sounds like. With -c,
+  this renders two seconds of every generator with fixed settings and
+  seeds, both the recipe versions and the block versions, and the Synth
+  with each of its oscillators. The output is compared to golden.txt:
+
+  $ ./bench -c golden.txt
+
+  First, the block versions of the noise generators are compared to the
+  recipes they come from. White noise, LFSR noise and filtered noise must
+  give exactly the same samples as calling the recipe once per sample,
+  even when the blocks have odd sizes. The explosion's render() may move a
+  turning point by a sample, so it only has to sound the same. So do the
+  wavetable oscillators and the envelopes, which compute their positions
+  and levels a little differently in blocks than one sample at a time.
+
+  Then every output is compared to the reference. An output is stored as
+  a hash of its exact samples, its RMS level, and its level in 8
+  frequency bands an octave apart. If the hash matches, the output is
+  bit-exact. If not, the output still passes when the levels are
+  within 0.1 dB and the bands within 1 dB. That allows for the small
+  rounding differences between the SIMD paths of the sine kernel and
+  between CPUs, but not for a bug. The time it took to render each output
+  is printed alongside. Any failure makes the program return -1.
+
+  After a change that is supposed to alter the sound, run it with -r to
+  record the new reference, and listen to the result.
+
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "../dsp/Envelope.h"
+#include "../dsp/Explosion.h"
+#include "../dsp/MathConstants.h"
+#include "../dsp/Noise.h"
+#include "../dsp/Oversampler.h"
+#include "../dsp/PitchTable.h"
+#include "../dsp/SafetyLimiter.h"
+#include "../dsp/SineKernel.h"
+#include "../dsp/Synth.h"
+#include "../dsp/Wavetable.h"
+
+//==============================================================================
+// Measuring
+//==============================================================================
+
+struct Result
+{
+    std::string kernel;
+    std::string path;
+    int blockSize;
+    double sampleRate;
+    double nsPerSample;
+};
+
+double minimumTime = 0.02;  // seconds per measurement
+
+// Every benchmark adds its output to this, so the compiler can't remove
+// the work as unused.
+volatile float sink;
+
+/*
+  Calls `renderBlock` over and over until `minimumTime` has passed, and does
+  that three times. The fastest of the three is the result, as the slower
+  runs were most likely interrupted by something else.
+ */
+double measure(int blockSize, const std::function<void(float*, int)>& renderBlock)
+{
+    typedef std::chrono::steady_clock Clock;
+    std::vector<float> block(blockSize);
+
+    double best = 1e30;
+    for (int run = 0; run < 3; ++run) {
+        long long samples = 0;
+        Clock::time_point start = Clock::now();
+        double elapsed = 0.0;
+        do {
+            for (int i = 0; i < 64; ++i) {
+                renderBlock(block.data(), blockSize);
+            }
+            samples += 64LL * blockSize;
+            elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        } while (elapsed < minimumTime);
+
+        best = std::min(best, elapsed * 1e9 / double(samples));
+        sink = sink + block[blockSize - 1];
+    }
+    return best;
+}
+
+//==============================================================================
+// The per-sample versions, as written in the recipes
+//==============================================================================
+
+struct ScalarSine
+{
+    double phase = 0.0;
+    double inc = 0.0;
+
+    float operator()()
+    {
+        float value = float(std::sin(phase));
+        phase += inc;
+        if (phase >= TWO_PI) {
+            phase -= TWO_PI;
+        }
+        return value;
+    }
+};
+
+// The LCG from white-noise.markdown, with the top 23 bits put into the
+// mantissa of 1.0f to make a float in [1, 2), which then becomes [-1, 1).
+struct ScalarWhiteNoise
+{
+    uint32_t seed = 22222;
+
+    float operator()()
+    {
+        seed = seed * 196314165 + 907633515;
+        uint32_t bits = 0x3F800000 | (seed >> 9);
+        float f;
+        std::memcpy(&f, &bits, sizeof(f));
+        return f * 2.0f - 3.0f;
+    }
+};
+
+// LFSRNoise from lfsr-noise.markdown.
+struct ScalarLFSR
+{
+    uint32_t seed = 0x55555555;
+
+    float operator()()
+    {
+        if (seed & 1) {
+            seed = (seed >> 1) ^ 0x80000062;
+        } else {
+            seed >>= 1;
+        }
+        return (float((seed >> 7) & 0x1FFFFFF) - 16777216.0f) / 16777216.0f;
+    }
+};
+
+/*
+  A wavetable oscillator the usual way: the read position is kept in table
+  elements, moves ahead one step per sample, and wraps around the end. The
+  block version computes the position from the start of the block instead,
+  so the two can differ in the last bits.
+ */
+struct ScalarWavetable
+{
+    ScalarWavetable(double inc, Waveform waveform, Interpolation interpolation)
+        : interpolation(interpolation)
+    {
+        table = Wavetables::shared().table(waveform, Wavetables::levelForIncrement(inc));
+        step = inc * INV_TWO_PI * double(Wavetables::tableSize);
+    }
+
+    float operator()()
+    {
+        int index = int(position);
+        float frac = float(position - double(index));
+        float value;
+        if (interpolation == Interpolation::cubic) {
+            float xm1 = table[index - 1];
+            float x0  = table[index];
+            float x1  = table[index + 1];
+            float x2  = table[index + 2];
+            float c1 = 0.5f * (x1 - xm1);
+            float c2 = xm1 - 2.5f * x0 + 2.0f * x1 - 0.5f * x2;
+            float c3 = 0.5f * (x2 - xm1) + 1.5f * (x0 - x1);
+            value = ((c3 * frac + c2) * frac + c1) * frac + x0;
+        } else {
+            value = table[index] + frac * (table[index + 1] - table[index]);
+        }
+
+        position += step;
+        if (position >= double(Wavetables::tableSize)) {
+            position -= double(Wavetables::tableSize);
+        }
+        return value;
+    }
+
+    const float* table;
+    Interpolation interpolation;
+    double position = 0.0;
+    double step;
+};
+
+/*
+  There is no envelope recipe, so the per-sample version is the Envelope
+  itself, asked for one sample at a time. That is what an envelope with a
+  stage check on every sample costs, which render() is meant to avoid.
+ */
+struct ScalarEnvelope
+{
+    float operator()()
+    {
+        float value;
+        envelope.render(&value, 1);
+        return value;
+    }
+
+    Envelope envelope;
+};
+
+struct ScalarLimiter
+{
+    void operator()(float* buffer, int sampleCount)
+    {
+        for (int i = 0; i < sampleCount; ++i) {
+            float x = buffer[i];
+            if (std::isnan(x) || std::isinf(x) || x < -2.0f || x > 2.0f) {
+                std::memset(buffer, 0, sampleCount * sizeof(float));
+                return;
+            } else if (x < -1.0f) {
+                buffer[i] = -1.0f;
+            } else if (x > 1.0f) {
+                buffer[i] = 1.0f;
+            }
+        }
+    }
+};
+
+//==============================================================================
+// The benchmarks
+//==============================================================================
+
+void benchmark(std::vector<Result>& results, int blockSize, double sampleRate)
+{
+    const double inc = 261.63 * TWO_PI / sampleRate;
+
+    auto add = [&](const char* kernel, const char* path, const std::function<void(float*, int)>& fn) {
+        results.push_back({ kernel, path, blockSize, sampleRate, measure(blockSize, fn) });
+    };
+
+    ScalarSine scalarSine;
+    scalarSine.inc = inc;
+    add("sine", "scalar", [&](float* out, int n) {
+        for (int i = 0; i < n; ++i) { out[i] = scalarSine(); }
+    });
+
+    double phase = 0.0;
+    add("sine", "block", [&](float* out, int n) {
+        renderSine(out, n, phase, inc);
+        phase = std::fmod(phase + n * inc, TWO_PI);
+    });
+
+    add("sineQuadrature", "block", [&](float* out, int n) {
+        renderSineQuadrature(out, n, phase, inc);
+        phase = std::fmod(phase + n * inc, TWO_PI);
+    });
+
+    ScalarWavetable scalarSaw(inc, Waveform::saw, Interpolation::cubic);
+    add("wavetableSaw", "scalar", [&](float* out, int n) {
+        for (int i = 0; i < n; ++i) { out[i] = scalarSaw(); }
+    });
+
+    add("wavetableSaw", "block", [&](float* out, int n) {
+        renderWavetable(out, n, phase, inc, Waveform::saw, Interpolation::cubic);
+        phase = std::fmod(phase + n * inc, TWO_PI);
+    });
+
+    ScalarWavetable scalarSawLinear(inc, Waveform::saw, Interpolation::linear);
+    add("wavetableSawLinear", "scalar", [&](float* out, int n) {
+        for (int i = 0; i < n; ++i) { out[i] = scalarSawLinear(); }
+    });
+
+    add("wavetableSawLinear", "block", [&](float* out, int n) {
+        renderWavetable(out, n, phase, inc, Waveform::saw, Interpolation::linear);
+        phase = std::fmod(phase + n * inc, TWO_PI);
+    });
+
+    ScalarWhiteNoise scalarWhite;
+    add("whiteNoise", "scalar", [&](float* out, int n) {
+        for (int i = 0; i < n; ++i) { out[i] = scalarWhite(); }
+    });
+
+    uint32_t whiteSeed = 22222;
+    add("whiteNoise", "block", [&](float* out, int n) {
+        renderWhiteNoise(out, n, whiteSeed);
+    });
+
+    ScalarLFSR scalarLFSR;
+    add("lfsrNoise", "scalar", [&](float* out, int n) {
+        for (int i = 0; i < n; ++i) { out[i] = scalarLFSR(); }
+    });
+
+    uint32_t lfsrSeed = 0x55555555;
+    add("lfsrNoise", "block", [&](float* out, int n) {
+        renderLFSRNoise(out, n, lfsrSeed);
+    });
+
+    FilteredNoise filteredNoise(22222);
+    filteredNoise.setCutoff(1000.0f, float(sampleRate));
+    add("filteredNoise", "scalar", [&](float* out, int n) {
+        for (int i = 0; i < n; ++i) { out[i] = filteredNoise(); }
+    });
+
+    add("filteredNoise", "block", [&](float* out, int n) {
+        filteredNoise.render(out, n);
+    });
+
+    // The explosion stops after a while, so restart it whenever it did.
+    for (int path = 0; path < 2; ++path) {
+        Explosion explosion(22222);
+        explosion.start(float(sampleRate));
+        long long explosionSamples = 0;
+        add("explosion", path == 0 ? "scalar" : "block", [&](float* out, int n) {
+            if (path == 0) {
+                for (int i = 0; i < n; ++i) { out[i] = explosion(); }
+            } else {
+                explosion.render(out, n);
+            }
+            explosionSamples += n;
+            if (explosionSamples > (long long)(sampleRate * 2.0)) {
+                explosion = Explosion(uint32_t(explosionSamples));
+                explosion.start(float(sampleRate));
+                explosionSamples = 0;
+            }
+        });
+    }
+
+    // One long attack and release, so that the benchmark spends nearly all
+    // of its time in those segments and not in sustain.
+    EnvelopeSettings settings;
+    settings.attack = 1.0;
+    settings.decay = 0.0;
+    settings.sustain = 1.0;
+    settings.release = 1.0;
+    for (int path = 0; path < 4; ++path) {
+        const int shape = path / 2;
+        settings.shape = static_cast<EnvelopeShape>(shape);
+        ScalarEnvelope scalar;
+        Envelope& envelope = scalar.envelope;
+        bool released = false;
+        add(shape == 0 ? "envelopeLinear" : "envelopeExponential",
+            (path & 1) == 0 ? "scalar" : "block", [&](float* out, int n) {
+            if (envelope.isIdle()) {
+                envelope.noteOn(settings, sampleRate);
+                released = false;
+            } else if (!released && envelope.getLevel() >= 1.0f) {
+                envelope.noteOff(settings, sampleRate);
+                released = true;
+            }
+            if ((path & 1) == 0) {
+                for (int i = 0; i < n; ++i) { out[i] = scalar(); }
+            } else {
+                envelope.render(out, n);
+            }
+        });
+    }
+
+    // Measured per output sample, so this includes filtering the 2 or 4
+    // input samples that make up each one.
+    for (int factor = 2; factor <= 4; factor *= 2) {
+        Oversampler oversampler;
+        oversampler.prepare(blockSize);
+        std::vector<float> input(blockSize * factor);
+        renderWhiteNoise(input.data(), blockSize * factor, whiteSeed);
+        add(factor == 2 ? "decimate2x" : "decimate4x", "block", [&](float* out, int n) {
+            oversampler.decimate(input.data(), out, n, factor);
+        });
+    }
+
+    // Turning a modulation signal, in octaves, into a pitch ratio.
+    std::vector<float> modulation(blockSize);
+    for (int i = 0; i < blockSize; ++i) { modulation[i] = float(i) / float(blockSize) - 0.5f; }
+
+    add("exp2", "scalar", [&](float* out, int n) {
+        for (int i = 0; i < n; ++i) { out[i] = std::exp2(modulation[i]); }
+    });
+
+    add("exp2", "block", [&](float* out, int n) {
+        fastExp2(modulation.data(), out, n);
+    });
+
+    // The limiter runs on audio that is fine, which is the usual case.
+    std::vector<float> audio(blockSize);
+    renderSine(audio.data(), blockSize, 0.0, inc);
+
+    ScalarLimiter scalarLimiter;
+    add("limiter", "scalar", [&](float* out, int n) {
+        std::memcpy(out, audio.data(), n * sizeof(float));
+        scalarLimiter(out, n);
+    });
+
+    add("limiter", "block", [&](float* out, int n) {
+        std::memcpy(out, audio.data(), n * sizeof(float));
+        protectYourEars(out, n);
+    });
+}
+
+//==============================================================================
+// Checking the output against a reference
+//==============================================================================
+
+const int numBands = 8;
+
+/*
+  A summary of a rendered output that can be stored in a text file. The
+  levels are in dB.
+ */
+struct Signature
+{
+    std::string name;
+    uint64_t hash;
+    float rms;
+    float bands[numBands];
+    double nsPerSample;
+};
+
+// FNV-1a over the bits of the samples, so that any change shows up.
+uint64_t hashSamples(const std::vector<float>& samples)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (float sample : samples) {
+        uint32_t bits;
+        std::memcpy(&bits, &sample, sizeof(bits));
+        for (int i = 0; i < 4; ++i) {
+            hash = (hash ^ ((bits >> (i * 8)) & 0xFF)) * 1099511628211ULL;
+        }
+    }
+    return hash;
+}
+
+float decibels(double power)
+{
+    return float(std::max(10.0 * std::log10(power), -120.0));
+}
+
+/*
+  The level at 8 frequencies, from 94 Hz to 12 kHz at 48 kHz, averaged over
+  Hann-windowed frames of 1024 samples. Each band is a single DFT bin found
+  with the Goertzel algorithm, which is plenty to notice when a kernel goes
+  out of tune, loses its high end, or turns into noise.
+ */
+void measureBands(const std::vector<float>& samples, float* bands)
+{
+    const int frameSize = 1024;
+    const int frameCount = int(samples.size()) / frameSize;
+
+    for (int band = 0; band < numBands; ++band) {
+        const int bin = 2 << band;
+        const double coeff = 2.0 * std::cos(TWO_PI * bin / frameSize);
+        double power = 0.0;
+
+        for (int frame = 0; frame < frameCount; ++frame) {
+            const float* x = samples.data() + frame * frameSize;
+            double s1 = 0.0, s2 = 0.0;
+            for (int i = 0; i < frameSize; ++i) {
+                const double window = 0.5 - 0.5 * std::cos(TWO_PI * i / frameSize);
+                const double s0 = x[i] * window + coeff * s1 - s2;
+                s2 = s1;
+                s1 = s0;
+            }
+            power += (s1 * s1 + s2 * s2 - coeff * s1 * s2) / (frameSize * frameSize);
+        }
+        bands[band] = decibels(power / std::max(frameCount, 1));
+    }
+}
+
+/*
+  Renders an output three times. The fastest time is kept, and all three
+  must be the same, or the output depends on something other than its
+  settings and seed.
+ */
+bool sign(std::vector<Signature>& signatures, const char* name, int sampleCount,
+          const std::function<void(float*, int)>& render)
+{
+    typedef std::chrono::steady_clock Clock;
+    std::vector<float> samples(sampleCount);
+    std::vector<float> previous;
+    double best = 1e30;
+
+    for (int run = 0; run < 3; ++run) {
+        std::fill(samples.begin(), samples.end(), 0.0f);
+        Clock::time_point start = Clock::now();
+        render(samples.data(), sampleCount);
+        const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        best = std::min(best, elapsed * 1e9 / double(sampleCount));
+
+        if (run > 0 && samples != previous) {
+            printf("Error: %s is different every time it is rendered.\n", name);
+            return false;
+        }
+        previous = samples;
+    }
+
+    Signature signature;
+    signature.name = name;
+    signature.hash = hashSamples(samples);
+    double sum = 0.0;
+    for (float sample : samples) {
+        sum += double(sample) * double(sample);
+    }
+    signature.rms = decibels(sum / double(sampleCount));
+    measureBands(samples, signature.bands);
+    signature.nsPerSample = best;
+    signatures.push_back(signature);
+    return true;
+}
+
+/*
+  Calls `render` on blocks of uneven sizes, to check that a block version
+  continues exactly where the previous block left off.
+ */
+void renderInBlocks(float* output, int sampleCount, const std::function<void(float*, int)>& render)
+{
+    const int blockSizes[] = { 1, 7, 64, 333, 1024, 2 };
+    for (int offset = 0, i = 0; offset < sampleCount; i = (i + 1) % 6) {
+        const int blockLength = std::min(blockSizes[i], sampleCount - offset);
+        render(output + offset, blockLength);
+        offset += blockLength;
+    }
+}
+
+/*
+  Plays one note for a second and then lets it go, rendered in blocks of
+  512 samples like a plug-in would.
+ */
+void renderNote(float* output, int sampleCount, const SynthSettings& settings)
+{
+    const int blockSize = 512;
+    Synth synth;
+    synth.prepare(48000.0, blockSize, 1, 1);
+    synth.setSettings(settings);
+
+    const int noteOffAt = 48000;
+    for (int offset = 0; offset < sampleCount; offset += blockSize) {
+        const int blockLength = std::min(blockSize, sampleCount - offset);
+        MidiEvent events[1];
+        int eventCount = 0;
+        if (offset == 0) {
+            events[eventCount++] = { 0, { 0x90, 60, 127 } };
+        } else if (noteOffAt >= offset && noteOffAt < offset + blockLength) {
+            events[eventCount++] = { noteOffAt - offset, { 0x80, 60, 0 } };
+        }
+        float* outputs[1] = { output + offset };
+        synth.render(outputs, blockLength, events, eventCount);
+    }
+}
+
+/*
+  Everything that gets checked. The names are the keys in the reference
+  file, so renaming one means recording a new reference.
+ */
+bool signAll(std::vector<Signature>& signatures)
+{
+    const double sampleRate = 48000.0;
+    const int sampleCount = 2 * 48000;
+    const double inc = 261.63 * TWO_PI / sampleRate;
+    bool ok = true;
+
+    auto add = [&](const char* name, const std::function<void(float*, int)>& render) {
+        ok = sign(signatures, name, sampleCount, render) && ok;
+    };
+
+    add("sine/block", [&](float* out, int n) {
+        renderSine(out, n, 0.0, inc);
+    });
+
+    add("sineQuadrature/block", [&](float* out, int n) {
+        renderSineQuadrature(out, n, 0.0, inc);
+    });
+
+    add("wavetableSaw/scalar", [&](float* out, int n) {
+        ScalarWavetable saw(inc, Waveform::saw, Interpolation::cubic);
+        for (int i = 0; i < n; ++i) { out[i] = saw(); }
+    });
+
+    add("wavetableSaw/block", [&](float* out, int n) {
+        renderWavetable(out, n, 0.0, inc, Waveform::saw, Interpolation::cubic);
+    });
+
+    add("wavetableSawLinear/scalar", [&](float* out, int n) {
+        ScalarWavetable saw(inc, Waveform::saw, Interpolation::linear);
+        for (int i = 0; i < n; ++i) { out[i] = saw(); }
+    });
+
+    add("wavetableSawLinear/block", [&](float* out, int n) {
+        renderWavetable(out, n, 0.0, inc, Waveform::saw, Interpolation::linear);
+    });
+
+    add("whiteNoise/scalar", [&](float* out, int n) {
+        ScalarWhiteNoise noise;
+        for (int i = 0; i < n; ++i) { out[i] = noise(); }
+    });
+
+    add("whiteNoise/block", [&](float* out, int n) {
+        uint32_t seed = 22222;
+        renderInBlocks(out, n, [&](float* block, int length) {
+            renderWhiteNoise(block, length, seed);
+        });
+    });
+
+    add("lfsrNoise/scalar", [&](float* out, int n) {
+        ScalarLFSR noise;
+        for (int i = 0; i < n; ++i) { out[i] = noise(); }
+    });
+
+    add("lfsrNoise/block", [&](float* out, int n) {
+        uint32_t seed = 0x55555555;
+        renderInBlocks(out, n, [&](float* block, int length) {
+            renderLFSRNoise(block, length, seed);
+        });
+    });
+
+    add("filteredNoise/scalar", [&](float* out, int n) {
+        FilteredNoise noise(22222);
+        noise.setCutoff(1000.0f, float(sampleRate));
+        for (int i = 0; i < n; ++i) { out[i] = noise(); }
+    });
+
+    add("filteredNoise/block", [&](float* out, int n) {
+        FilteredNoise noise(22222);
+        noise.setCutoff(1000.0f, float(sampleRate));
+        renderInBlocks(out, n, [&](float* block, int length) {
+            noise.render(block, length);
+        });
+    });
+
+    add("explosion/scalar", [&](float* out, int n) {
+        Explosion explosion(22222);
+        explosion.start(float(sampleRate));
+        for (int i = 0; i < n; ++i) { out[i] = explosion(); }
+    });
+
+    add("explosion/block", [&](float* out, int n) {
+        Explosion explosion(22222);
+        explosion.start(float(sampleRate));
+        renderInBlocks(out, n, [&](float* block, int length) {
+            explosion.render(block, length);
+        });
+    });
+
+    // A full note with every stage, released after one second.
+    EnvelopeSettings envelopeSettings;
+    envelopeSettings.attack = 0.2;
+    envelopeSettings.decay = 0.3;
+    envelopeSettings.sustain = 0.5;
+    envelopeSettings.release = 0.5;
+    for (int path = 0; path < 4; ++path) {
+        const int shape = path / 2;
+        const bool scalar = (path & 1) == 0;
+        const char* names[] = {
+            "envelopeLinear/scalar", "envelopeLinear/block",
+            "envelopeExponential/scalar", "envelopeExponential/block",
+        };
+        envelopeSettings.shape = static_cast<EnvelopeShape>(shape);
+        add(names[path], [&](float* out, int n) {
+            const int noteOffAt = 48000;
+            ScalarEnvelope scalarEnvelope;
+            Envelope& envelope = scalarEnvelope.envelope;
+            auto renderPart = [&](float* part, int length) {
+                if (scalar) {
+                    for (int i = 0; i < length; ++i) { part[i] = scalarEnvelope(); }
+                } else {
+                    renderInBlocks(part, length, [&](float* block, int blockLength) {
+                        envelope.render(block, blockLength);
+                    });
+                }
+            };
+            envelope.noteOn(envelopeSettings, sampleRate);
+            renderPart(out, noteOffAt);
+            envelope.noteOff(envelopeSettings, sampleRate);
+            renderPart(out + noteOffAt, n - noteOffAt);
+        });
+    }
+
+    // The Synth with each oscillator, which is what the plug-in and the
+    // command line tool play.
+    const char* oscillators[] = {
+        "synth/sine", "synth/wavetableSine", "synth/saw", "synth/square", "synth/triangle",
+        "synth/whiteNoise", "synth/lfsrNoise", "synth/filteredNoise", "synth/explosion",
+        "synth/sineQuadrature",
+    };
+    for (int oscillator = 0; oscillator < 10; ++oscillator) {
+        SynthSettings settings;
+        settings.oscillator = oscillator;
+        add(oscillators[oscillator], [&](float* out, int n) {
+            renderNote(out, n, settings);
+        });
+    }
+
+    SynthSettings settings;
+    settings.oscillator = 2;
+    settings.oversampling = 4;
+    add("synth/saw4x", [&](float* out, int n) {
+        renderNote(out, n, settings);
+    });
+
+    // Vibrato and tremolo from the modulation matrix.
+    settings.oversampling = 1;
+    settings.modulation.routes[0].destination = ModDestination::pitch;
+    settings.modulation.routes[0].amount = 0.5f;
+    settings.modulation.routes[1].source = ModSource::lfo2;
+    settings.modulation.routes[1].destination = ModDestination::amplitude;
+    settings.modulation.routes[1].amount = 0.3f;
+    settings.modulation.lfo[1].rate = 3.0f;
+    settings.modulation.routeCount = 2;
+    add("synth/sawModulated", [&](float* out, int n) {
+        renderNote(out, n, settings);
+    });
+
+    return ok;
+}
+
+bool writeReference(const char* filename, const std::vector<Signature>& signatures)
+{
+    FILE* f = fopen(filename, "w");
+    if (!f) {
+        printf("Error: could not open %s for writing.\n", filename);
+        return false;
+    }
+    fprintf(f, "# Reference output for bench -c. Recorded with the %s sine kernel.\n", sineKernelName());
+    fprintf(f, "# name, hash, RMS level and %d band levels in dB\n", numBands);
+    for (const Signature& s : signatures) {
+        fprintf(f, "%s %016llx %.2f", s.name.c_str(), (unsigned long long)s.hash, s.rms);
+        for (int band = 0; band < numBands; ++band) {
+            fprintf(f, " %.2f", s.bands[band]);
+        }
+        fprintf(f, "\n");
+    }
+    fclose(f);
+    return true;
+}
+
+bool readReference(const char* filename, std::vector<Signature>& signatures)
+{
+    FILE* f = fopen(filename, "r");
+    if (!f) {
+        printf("Error: could not open reference file %s.\n", filename);
+        return false;
+    }
+
+    char line[512];
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+        char name[128];
+        unsigned long long hash;
+        Signature s;
+        float* b = s.bands;
+        if (sscanf(line, "%127s %llx %f %f %f %f %f %f %f %f %f", name, &hash, &s.rms,
+                   &b[0], &b[1], &b[2], &b[3], &b[4], &b[5], &b[6], &b[7]) != 3 + numBands) {
+            printf("Error: %s has a line that could not be read: %s", filename, line);
+            fclose(f);
+            return false;
+        }
+        s.name = name;
+        s.hash = hash;
+        s.nsPerSample = 0.0;
+        signatures.push_back(s);
+    }
+    fclose(f);
+    return true;
+}
+
+/*
+  True if two outputs that are not bit-exact sound the same. `worst` is
+  set to the largest difference between their bands.
+ */
+bool soundsTheSame(const Signature& a, const Signature& b, float& worst)
+{
+    // The bands of a pure tone are mostly leakage far below the tone
+    // itself, so only bands that are loud enough to hear are compared.
+    worst = 0.0f;
+    for (int band = 0; band < numBands; ++band) {
+        if (a.bands[band] > -80.0f || b.bands[band] > -80.0f) {
+            worst = std::max(worst, std::fabs(a.bands[band] - b.bands[band]));
+        }
+    }
+    return std::fabs(a.rms - b.rms) <= 0.1f && worst <= 1.0f;
+}
+
+const Signature* findSignature(const std::vector<Signature>& signatures, const std::string& name)
+{
+    for (const Signature& s : signatures) {
+        if (s.name == name) {
+            return &s;
+        }
+    }
+    return nullptr;
+}
+
+/*
+  Compares the block versions of the generators to the recipes. Returns
+  the number that fail.
+ */
+int compareToRecipes(const std::vector<Signature>& signatures)
+{
+    struct RecipeCheck
+    {
+        const char* kernel;
+        bool mustBeExact;
+    };
+    const RecipeCheck checks[] = {
+        { "wavetableSaw", false },
+        { "wavetableSawLinear", false },
+        { "envelopeLinear", false },
+        { "envelopeExponential", false },
+        { "whiteNoise", true },
+        { "lfsrNoise", true },
+        { "filteredNoise", true },
+        { "explosion", false },
+    };
+
+    int failures = 0;
+    for (const RecipeCheck& check : checks) {
+        const std::string kernel = check.kernel;
+        const Signature* block = findSignature(signatures, kernel + "/block");
+        const Signature* recipe = findSignature(signatures, kernel + "/scalar");
+
+        const char* verdict = "exact";
+        float worst = 0.0f;
+        if (block->hash != recipe->hash) {
+            const bool close = !check.mustBeExact && soundsTheSame(*block, *recipe, worst);
+            verdict = close ? "close" : "FAILED";
+            failures += close ? 0 : 1;
+        }
+        printf("%-26s %-7s %7.2f dB  %5.2f dB off  (block versus recipe)\n",
+               kernel.c_str(), verdict, block->rms, worst);
+    }
+    return failures;
+}
+
+/*
+  Prints one line per output, and returns the number of outputs that fail.
+  Outputs that are not in the reference also count as failures, so that a
+  new kernel can't slip past without a recorded reference.
+ */
+int compareToReference(const std::vector<Signature>& signatures, const std::vector<Signature>& reference)
+{
+    int failures = 0;
+    for (const Signature& s : signatures) {
+        const Signature* found = findSignature(reference, s.name);
+
+        const char* verdict = "exact";
+        float worst = 0.0f;
+        if (found == nullptr) {
+            verdict = "MISSING";
+            failures += 1;
+        } else if (found->hash != s.hash) {
+            const bool close = soundsTheSame(*found, s, worst);
+            verdict = close ? "close" : "FAILED";
+            failures += close ? 0 : 1;
+        }
+
+        printf("%-26s %-7s %7.2f dB  %5.2f dB off  %7.3f ns/sample\n",
+               s.name.c_str(), verdict, s.rms, worst, s.nsPerSample);
+    }
+    return failures;
+}
+
+//==============================================================================
+// Writing the results
+//==============================================================================
+
+void writeJSON(FILE* f, const std::vector<Result>& results)
+{
+    fprintf(f, "{ \"sineKernel\": \"%s\", \"results\": [\n", sineKernelName());
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        fprintf(f, "  { \"kernel\": \"%s\", \"path\": \"%s\", \"blockSize\": %d, "
+                   "\"sampleRate\": %g, \"nsPerSample\": %.4f, \"voicesPerCore\": %.0f }%s\n",
+                r.kernel.c_str(), r.path.c_str(), r.blockSize, r.sampleRate, r.nsPerSample,
+                1e9 / (r.nsPerSample * r.sampleRate), (i + 1 < results.size()) ? "," : "");
+    }
+    fprintf(f, "] }\n");
+}
+
+int main(int argc, char* argv[])
+{
+    const char* outputFile = nullptr;
+    const char* checkFile = nullptr;
+    const char* recordFile = nullptr;
+
+    for (int arg = 1; arg < argc; ++arg) {
+        if (strcmp(argv[arg], "-o") == 0 && arg + 1 < argc) {
+            outputFile = argv[++arg];
+        } else if (strcmp(argv[arg], "-t") == 0 && arg + 1 < argc) {
+            minimumTime = std::max(atof(argv[++arg]), 1.0) * 0.001;
+        } else if (strcmp(argv[arg], "-c") == 0 && arg + 1 < argc) {
+            checkFile = argv[++arg];
+        } else if (strcmp(argv[arg], "-r") == 0 && arg + 1 < argc) {
+            recordFile = argv[++arg];
+        } else {
+            printf("Usage: %s [-o results.json] [-t milliseconds] [-c golden.txt] [-r golden.txt]\n", argv[0]);
+            return -1;
+        }
+    }
+
+    // Build the tables before measuring anything.
+    Wavetables::shared();
+
+    if (checkFile != nullptr || recordFile != nullptr) {
+        std::vector<Signature> signatures;
+        if (!signAll(signatures)) {
+            return -1;
+        }
+
+        // A block version that doesn't match its recipe is a bug, so that
+        // must never end up in a reference either.
+        if (compareToRecipes(signatures) > 0) {
+            printf("Error: the block versions do not match the recipes.\n");
+            return -1;
+        }
+        if (recordFile != nullptr) {
+            return writeReference(recordFile, signatures) ? 0 : -1;
+        }
+
+        std::vector<Signature> reference;
+        if (!readReference(checkFile, reference)) {
+            return -1;
+        }
+        const int failures = compareToReference(signatures, reference);
+        printf("%d of %d outputs failed (%s sine kernel)\n", failures, int(signatures.size()), sineKernelName());
+        return failures == 0 ? 0 : -1;
+    }
+
+    std::vector<Result> results;
+    const int blockSizes[] = { 32, 64, 128, 256, 512, 1024 };
+    const double sampleRates[] = { 44100.0, 48000.0, 96000.0 };
+    for (double sampleRate : sampleRates) {
+        for (int blockSize : blockSizes) {
+            benchmark(results, blockSize, sampleRate);
+        }
+    }
+
+    FILE* f = stdout;
+    if (outputFile != nullptr) {
+        f = fopen(outputFile, "w");
+        if (!f) {
+            printf("Error: could not open %s for writing.\n", outputFile);
+            return -1;
+        }
+    }
+
+    writeJSON(f, results);
+
+    if (f != stdout) {
+        fclose(f);
+    }
+    return 0;
+}
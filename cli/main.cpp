@@ -1,67 +1,351 @@
 /*
 
   Compile and run this on macOS:
-  $ clang -std=c++11 -lstdc++ -Wall -Wextra main.cpp -o synth
+  $ clang -std=c++11 -lstdc++ -O2 -Wall -Wextra main.cpp ../dsp/Envelope.cpp ../dsp/Modulation.cpp ../dsp/Noise.cpp ../dsp/Oversampler.cpp ../dsp/PitchTable.cpp ../dsp/SafetyLimiter.cpp ../dsp/SineKernel.cpp ../dsp/Synth.cpp ../dsp/Wavetable.cpp -o synth
   $ ./synth
 
   Compile and run this on Windows:
   TODO
 
   Compile and run this on Linux:
-  TODO
+  $ g++ -std=c++11 -pthread -O2 -Wall -Wextra main.cpp ../dsp/Envelope.cpp ../dsp/Modulation.cpp ../dsp/Noise.cpp ../dsp/Oversampler.cpp ../dsp/PitchTable.cpp ../dsp/SafetyLimiter.cpp ../dsp/SineKernel.cpp ../dsp/Synth.cpp ../dsp/Wavetable.cpp -o synth
+  $ ./synth
+
+  Without arguments this plays a single note on the same Synth as the
+  plug-in uses, and renders it into output.wav as fast as possible. To
+  render a batch of sound effects in parallel, pass it a job list instead:
+  $ ./synth [options] [jobs.txt]
+
+  Or play a Standard MIDI File on the synth:
+  $ ./synth [options] -m song.mid [-o song.wav]
+
+  Options:
+    -j <threads>    number of threads to use for the job list
+    -f <format>     sample format: 16, 24 or float (default is 16)
+    -c <channels>   number of output channels (default is 1)
+    -dither         add TPDF dither when writing 16 or 24-bit samples
+    -rf64           allow the output to grow beyond 4 GB
+    -mmap           write the WAV file through a memory mapping
+    -m <song.mid>   render a MIDI file instead of a single note
+    -o <file.wav>   name of the output file (default is output.wav)
+
+  Every line in the job list describes one WAV file to render:
+
+      <generator> <seed> <seconds> <output.wav>
+
+  where the generator is one of explosion, white or lfsr. Empty lines and
+  lines starting with # are skipped. Each job only depends on its own seed,
+  so the output is the same no matter how many threads are used. Long white
+  and lfsr jobs are split into chunks that are rendered on all threads.
 
  */
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <cstdio>
+#include <cstdlib>
 #include <cmath>
+#include <cstring>
 #include <new>
+#include <string>
+#include <thread>
+#include <vector>
 
-constexpr double PI     = 3.14159265358979323846264338327950288;
-constexpr double TWO_PI = 6.28318530717958647692528676655900576;
-constexpr double SQRT2  = 1.41421356237309504880168872420969808;
+#include "../dsp/Explosion.h"
+#include "../dsp/Noise.h"
+#include "../dsp/Synth.h"
+#include "MidiFile.h"
+#include "WavWriter.h"
+#include "WorkStealingPool.h"
 
 //==============================================================================
 // Change these settings to use a different sampling rate or pitch
 //==============================================================================
 
 double sampleRate = 48000;
-double frequency  = 261.63;
-double amplitude  = 0.5;  // -6 dB
+int note          = 60;    // middle C
+int velocity      = 127;   // the synth turns this into an amplitude of 0.5
+double amplitude  = 0.5;   // -6 dB, for the job list
 
 double lengthInSeconds = 10;
 
+// Change these to hear the other sounds that the synth can make.
+SynthSettings synthSettings;
+
 //==============================================================================
-// Declare the variables for the synthesis algorithm here
+// Rendering MIDI events with the synth
 //==============================================================================
 
-double phase;
-double inc;
+/*
+  Renders a list of MIDI events with the Synth and writes the result to a
+  WAV file. The event positions are in samples from the start of the file,
+  sorted from early to late. Events past the end are ignored.
+
+  The synth has a mono or a stereo output. If the WAV file has more
+  channels than that, the synth's channels are repeated.
+ */
+bool renderMIDI(const std::vector<MidiEvent>& events, int sampleCount,
+                const char* filename, const WavFormat& format, bool writeInBackground)
+{
+    WavWriter writer;
+    if (!writer.open(filename, format, writeInBackground, sampleCount)) {
+        return false;
+    }
+
+    // Offline there is no audio device waiting for the next block, so the
+    // blocks can be much larger than in a plug-in. That means fewer calls
+    // into the synth and the WAV writer for the same amount of audio.
+    const int samplesPerBlock = 4096;
+    const int synthChannels = std::min(format.channels, 2);
+
+    Synth synth;
+    synth.prepare(format.sampleRate, samplesPerBlock, 1, synthChannels);
+    synth.setSettings(synthSettings);
+
+    std::vector<float> output(size_t(synthChannels) * samplesPerBlock);
+    std::vector<float*> synthOutputs(synthChannels);
+    for (int channel = 0; channel < synthChannels; ++channel) {
+        synthOutputs[channel] = output.data() + channel * samplesPerBlock;
+    }
+    std::vector<const float*> channels(format.channels);
+    for (int channel = 0; channel < format.channels; ++channel) {
+        channels[channel] = synthOutputs[channel % synthChannels];
+    }
+
+    // The synth wants the event positions relative to the start of each
+    // block, so the events for the current block are copied and moved.
+    std::vector<MidiEvent> blockEvents;
+    size_t next = 0;
+
+    for (int offset = 0; offset < sampleCount; offset += samplesPerBlock) {
+        int blockLength = std::min(samplesPerBlock, sampleCount - offset);
+
+        blockEvents.clear();
+        while (next < events.size() && events[next].position < offset + blockLength) {
+            MidiEvent event = events[next++];
+            event.position = std::max(event.position - offset, 0);
+            blockEvents.push_back(event);
+        }
+
+        synth.render(synthOutputs.data(), blockLength, blockEvents.data(), int(blockEvents.size()));
+        writer.write(channels.data(), blockLength);
+    }
+
+    return writer.close();
+}
 
 //==============================================================================
-// Implement the following methods to perform the sound synthesis algorithm
+// Batch rendering of sound effects from a job list
 //==============================================================================
 
-void reset()
+struct Job
+{
+    std::string generator;
+    uint32_t seed;
+    double seconds;
+    std::string filename;
+};
+
+bool readJobs(const char* filename, std::vector<Job>& jobs)
+{
+    FILE* f = fopen(filename, "r");
+    if (!f) {
+        printf("Error: could not open job list %s.\n", filename);
+        return false;
+    }
+
+    char line[1024];
+    int lineNumber = 0;
+    while (fgets(line, sizeof(line), f)) {
+        lineNumber += 1;
+        char generator[64], output[768];
+        unsigned long seed;
+        double seconds;
+
+        const char* text = line + strspn(line, " \t");
+        if (*text == '#' || *text == '\n' || *text == '\r' || *text == '\0') {
+            continue;
+        }
+        if (sscanf(text, "%63s %lu %lf %767s", generator, &seed, &seconds, output) != 4) {
+            printf("Error: %s line %d is not <generator> <seed> <seconds> <output.wav>\n",
+                   filename, lineNumber);
+            fclose(f);
+            return false;
+        }
+
+        std::string name = generator;
+        if (name != "explosion" && name != "white" && name != "lfsr") {
+            printf("Error: %s line %d has unknown generator %s\n", filename, lineNumber, generator);
+            fclose(f);
+            return false;
+        }
+
+        jobs.push_back({ name, static_cast<uint32_t>(seed), seconds, output });
+    }
+
+    fclose(f);
+    return true;
+}
+
+int jobLength(const Job& job)
+{
+    return static_cast<int>(sampleRate * job.seconds);
+}
+
+uint32_t noiseSeed(const Job& job)
+{
+    if (job.generator == "lfsr" && job.seed == 0) {
+        return 0x55555555;  // the LFSR gets stuck on zero
+    }
+    return job.seed;
+}
+
+/*
+  The noise generators can jump to any sample position, so a long noise job
+  can be rendered in pieces. The explosion can't, since every sample depends
+  on its filters and on the previous random numbers.
+ */
+bool canRenderInChunks(const Job& job)
 {
-    phase = 0.0;
-    inc = 0.0;
+    return job.generator == "white" || job.generator == "lfsr";
 }
 
-void startSound()
+/*
+  Renders a single job. This only reads the global settings and keeps all
+  synthesis state in local variables, so many jobs can run at once.
+ */
+bool renderJob(const Job& job, const WavFormat& format)
 {
-    inc = frequency * TWO_PI / sampleRate;
+    int sampleCount = jobLength(job);
+
+    // The jobs already keep all cores busy, so there's no point in writing
+    // each file from yet another thread.
+    WavWriter writer;
+    if (!writer.open(job.filename.c_str(), format, false, sampleCount)) {
+        return false;
+    }
+
+    Explosion explosion(job.seed);
+    explosion.start(static_cast<float>(sampleRate));
+
+    uint32_t seed = noiseSeed(job);
+
+    const int samplesPerBlock = 512;
+    float block[samplesPerBlock];
+
+    // The sound is mono, so every output channel gets the same samples.
+    std::vector<const float*> channels(format.channels, block);
+
+    for (int offset = 0; offset < sampleCount; offset += samplesPerBlock) {
+        int blockLength = std::min(samplesPerBlock, sampleCount - offset);
+
+        if (job.generator == "explosion") {
+            explosion.render(block, blockLength);
+        } else if (job.generator == "white") {
+            renderWhiteNoise(block, blockLength, seed);
+        } else {
+            renderLFSRNoise(block, blockLength, seed);
+        }
+
+        for (int sample = 0; sample < blockLength; ++sample) {
+            block[sample] *= static_cast<float>(amplitude);
+        }
+        writer.write(channels.data(), blockLength);
+    }
+
+    return writer.close();
+}
+
+/*
+  Renders a single noise job on all threads. The job is cut into chunks of
+  one second, and every chunk starts by jumping the seed ahead to its first
+  sample. That gives exactly the same samples as renderJob() does.
+
+  Holding the whole file in memory could take gigabytes, so the chunks are
+  done a few per thread at a time. While the background thread writes one
+  round to disk, the next round is already being rendered.
+ */
+bool renderJobInChunks(const Job& job, const WavFormat& format, WorkStealingPool& pool, int numThreads)
+{
+    const int sampleCount = jobLength(job);
+    const int chunkLength = static_cast<int>(sampleRate);
+    const int chunksPerRound = 4 * numThreads;
+
+    WavWriter writer;
+    if (!writer.open(job.filename.c_str(), format, true, sampleCount)) {
+        return false;
+    }
+
+    const uint32_t seed = noiseSeed(job);
+    std::vector<float> round(size_t(chunksPerRound) * chunkLength);
+
+    for (int roundStart = 0; roundStart < sampleCount; roundStart += chunksPerRound * chunkLength) {
+        const int roundLength = std::min(chunksPerRound * chunkLength, sampleCount - roundStart);
+        const int chunkCount = (roundLength + chunkLength - 1) / chunkLength;
+
+        pool.run(chunkCount, [&](int chunk) {
+            const int offset = chunk * chunkLength;
+            const int length = std::min(chunkLength, roundLength - offset);
+            float* output = round.data() + offset;
+
+            if (job.generator == "white") {
+                uint32_t chunkSeed = skipWhiteNoise(seed, uint64_t(roundStart) + offset);
+                renderWhiteNoise(output, length, chunkSeed);
+            } else {
+                uint32_t chunkSeed = skipLFSRNoise(seed, uint64_t(roundStart) + offset);
+                renderLFSRNoise(output, length, chunkSeed);
+            }
+
+            for (int sample = 0; sample < length; ++sample) {
+                output[sample] *= static_cast<float>(amplitude);
+            }
+        });
+
+        std::vector<const float*> channels(format.channels, round.data());
+        writer.write(channels.data(), roundLength);
+    }
+
+    return writer.close();
 }
 
-double processSample()
+int renderJobs(const char* filename, const WavFormat& format, int numThreads)
 {
-    double output = amplitude * std::sin(phase);
+    std::vector<Job> jobs;
+    if (!readJobs(filename, jobs)) {
+        return -1;
+    }
 
-    phase += inc;
-    if (phase > TWO_PI) {
-        phase -= TWO_PI;
+    // A noise job that is long enough to give every thread a chunk is split
+    // up across all the threads. The other jobs get a thread each.
+    std::vector<int> wholeJobs, chunkedJobs;
+    for (int index = 0; index < int(jobs.size()); ++index) {
+        const Job& job = jobs[index];
+        if (numThreads > 1 && canRenderInChunks(job) && jobLength(job) >= int(sampleRate) * numThreads) {
+            chunkedJobs.push_back(index);
+        } else {
+            wholeJobs.push_back(index);
+        }
     }
 
-    return output;
+    std::atomic<int> failures(0);
+    WorkStealingPool pool(numThreads);
+    pool.run(int(wholeJobs.size()), [&](int index) {
+        if (!renderJob(jobs[wholeJobs[index]], format)) {
+            failures += 1;
+        }
+    });
+
+    for (int index : chunkedJobs) {
+        if (!renderJobInChunks(jobs[index], format, pool, numThreads)) {
+            failures += 1;
+        }
+    }
+
+    printf("Rendered %d of %d jobs using %d threads.\n",
+           int(jobs.size()) - failures.load(), int(jobs.size()), numThreads);
+    return (failures > 0) ? -1 : 0;
 }
 
 //==============================================================================
@@ -70,49 +354,91 @@ double processSample()
 
 int main(int argc, char* argv[])
 {
-    reset();
-    startSound();
+    WavFormat format;
+    format.sampleRate = sampleRate;
+
+    int numThreads = int(std::thread::hardware_concurrency());
+    const char* jobList = nullptr;
+    const char* midiFile = nullptr;
+    const char* outputFile = "output.wav";
 
-    int sampleCount = static_cast<int>(sampleRate * lengthInSeconds);
-    int16_t* outputBuffer = new int16_t[sampleCount];
+    for (int arg = 1; arg < argc; ++arg) {
+        const char* option = argv[arg];
+        bool hasValue = (arg + 1 < argc);
 
-    for (int sample = 0; sample < sampleCount; ++sample) {
-        double output = processSample();
-        outputBuffer[sample] = static_cast<int16_t>(output * 32767.0);
+        if (strcmp(option, "-j") == 0 && hasValue) {
+            numThreads = std::max(atoi(argv[++arg]), 1);
+        } else if (strcmp(option, "-f") == 0 && hasValue) {
+            const char* value = argv[++arg];
+            if (strcmp(value, "16") == 0) {
+                format.sampleFormat = SampleFormat::int16;
+            } else if (strcmp(value, "24") == 0) {
+                format.sampleFormat = SampleFormat::int24;
+            } else if (strcmp(value, "float") == 0) {
+                format.sampleFormat = SampleFormat::float32;
+            } else {
+                printf("Error: unknown sample format %s, use 16, 24 or float.\n", value);
+                return -1;
+            }
+        } else if (strcmp(option, "-c") == 0 && hasValue) {
+            format.channels = atoi(argv[++arg]);
+            if (format.channels < 1 || format.channels > 18) {
+                printf("Error: the number of channels must be between 1 and 18.\n");
+                return -1;
+            }
+        } else if (strcmp(option, "-dither") == 0) {
+            format.dither = true;
+        } else if (strcmp(option, "-rf64") == 0) {
+            format.rf64 = true;
+        } else if (strcmp(option, "-mmap") == 0) {
+            format.memoryMap = true;
+        } else if (strcmp(option, "-m") == 0 && hasValue) {
+            midiFile = argv[++arg];
+        } else if (strcmp(option, "-o") == 0 && hasValue) {
+            outputFile = argv[++arg];
+        } else if (option[0] != '-' && jobList == nullptr) {
+            jobList = option;
+        } else {
+            printf("Usage: %s [-j threads] [-f 16|24|float] [-c channels] [-dither] [-rf64] [-mmap] "
+                   "[-m song.mid] [-o output.wav] [jobs.txt]\n", argv[0]);
+            return -1;
+        }
     }
 
-    FILE* f = fopen("output.wav", "wb");
-    if (!f) {
-        printf("Error: could not open WAV file for writing.\n");
-        return -1;
+    if (jobList != nullptr) {
+        return renderJobs(jobList, format, numThreads);
     }
 
-    uint32_t dataLength = static_cast<uint32_t>(sampleCount * 2);
-    uint32_t length = 44 + dataLength;
-    uint32_t blockSize = 16;
-    uint16_t format = 1;    // PCM
-    uint16_t channels = 1;  // mono
-    uint32_t srate = static_cast<uint32_t>(sampleRate);
-    uint32_t bytesPerSecond = srate * 2;
-    uint16_t bytesPerSample = 2;
-    uint16_t bitsPerSample = 16;
-
-    fwrite("RIFF", 4, 1, f);
-    fwrite(&length, 4, 1, f);
-    fwrite("WAVE", 4, 1, f);
-    fwrite("fmt ", 4, 1, f);
-    fwrite(&blockSize, 4, 1, f);
-    fwrite(&format, 2, 1, f);
-    fwrite(&channels, 2, 1, f);
-    fwrite(&srate, 4, 1, f);
-    fwrite(&bytesPerSecond, 4, 1, f);
-    fwrite(&bytesPerSample, 2, 1, f);
-    fwrite(&bitsPerSample, 2, 1, f);
-    fwrite("data", 4, 1, f);
-    fwrite(&dataLength, 4, 1, f);
-    fwrite(outputBuffer, sampleCount, 2, f);
-    fclose(f);
+    const int releaseSamples = static_cast<int>(synthSettings.envelope.release * sampleRate);
+    std::vector<MidiEvent> events;
+    int sampleCount;
+
+    if (midiFile != nullptr) {
+        // Keep going after the end of the song until the last notes have
+        // been released.
+        MidiFile reader;
+        if (!reader.read(midiFile, sampleRate, events, sampleCount)) {
+            return -1;
+        }
+        sampleCount += releaseSamples;
+    } else {
+        // Play one note and release it just in time for the release to
+        // finish before the end of the file.
+        sampleCount = static_cast<int>(sampleRate * lengthInSeconds);
+        events.push_back({ 0, { 0x90, uint8_t(note), uint8_t(velocity) } });
+        events.push_back({ std::max(sampleCount - releaseSamples, 0), { 0x80, uint8_t(note), 0 } });
+    }
+
+    // The WAV file gets written to disk on a separate thread.
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+    if (!renderMIDI(events, sampleCount, outputFile, format, true)) {
+        return -1;
+    }
 
-    delete[] outputBuffer;
+    const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    const double seconds = double(sampleCount) / sampleRate;
+    printf("Rendered %.1f seconds of audio in %.1f ms, %.0f times real time.\n",
+           seconds, elapsed * 1000.0, seconds / std::max(elapsed, 1e-9));
     return 0;
 }
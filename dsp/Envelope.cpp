@@ -0,0 +1,125 @@
+#include "Envelope.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// How far past the end level the exponential segments aim. A small value
+// makes the decay and release curves steeper; the attack uses a larger
+// value, which gives it the typical convex shape of analog synths.
+constexpr double ATTACK_OVERSHOOT = 0.3;
+constexpr double DECAY_OVERSHOOT = 0.0001;
+
+int lengthInSamples(double seconds, double sampleRate)
+{
+    return std::max(int(std::round(seconds * sampleRate)), 0);
+}
+
+}  // namespace
+
+void Envelope::reset()
+{
+    stage = Stage::idle;
+    level = 0.0f;
+    remaining = 0;
+}
+
+void Envelope::noteOn(const EnvelopeSettings& settings, double sampleRate)
+{
+    shape = settings.shape;
+    decayLength = lengthInSamples(settings.decay, sampleRate);
+    sustainLevel = float(std::min(std::max(settings.sustain, 0.0), 1.0));
+
+    // When a note gets retriggered while it is still sounding, the attack
+    // starts from the current level, at the same speed as from silence.
+    const int attackLength = lengthInSamples(settings.attack * (1.0 - level), sampleRate);
+    startSegment(Stage::attack, 1.0f, attackLength);
+}
+
+void Envelope::noteOff(const EnvelopeSettings& settings, double sampleRate)
+{
+    if (stage != Stage::idle && stage != Stage::release) {
+        startSegment(Stage::release, 0.0f, lengthInSamples(settings.release, sampleRate));
+    }
+}
+
+void Envelope::startSegment(Stage newStage, float newEnd, int length)
+{
+    stage = newStage;
+    end = newEnd;
+    remaining = length;
+
+    if (length == 0) {
+        nextStage();
+        return;
+    }
+
+    step = (end - level) / float(length);
+
+    // Solve target + (level - target) * factor^length = end for the factor.
+    const double overshoot = (newStage == Stage::attack) ? ATTACK_OVERSHOOT : DECAY_OVERSHOOT;
+    const double start = level;
+    const double t = (end >= start) ? end + overshoot : end - overshoot;
+    target = float(t);
+    factor = float(std::pow((end - t) / (start - t), 1.0 / double(length)));
+}
+
+void Envelope::nextStage()
+{
+    level = end;
+
+    switch (stage) {
+        case Stage::attack:
+            startSegment(Stage::decay, sustainLevel, decayLength);
+            break;
+        case Stage::decay:
+            stage = Stage::sustain;
+            break;
+        case Stage::release:
+            stage = Stage::idle;
+            break;
+        default:
+            break;
+    }
+}
+
+void Envelope::render(float* output, int sampleCount)
+{
+    while (sampleCount > 0) {
+        if (stage == Stage::sustain || stage == Stage::idle) {
+            std::fill(output, output + sampleCount, level);
+            return;
+        }
+
+        const int count = std::min(remaining, sampleCount);
+
+        if (shape == EnvelopeShape::linear) {
+            const float start = level;
+            const float slope = step;
+            for (int i = 0; i < count; ++i) {
+                output[i] = start + float(i + 1) * slope;
+            }
+            level = start + float(count) * slope;
+        } else {
+            const float t = target;
+            const float k = factor;
+            float distance = level - t;
+            for (int i = 0; i < count; ++i) {
+                distance *= k;
+                output[i] = t + distance;
+            }
+            level = t + distance;
+        }
+
+        remaining -= count;
+        output += count;
+        sampleCount -= count;
+
+        if (remaining == 0) {
+            // Land exactly on the end level, so that rounding errors don't
+            // build up from one stage to the next.
+            nextStage();
+        }
+    }
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+
+enum class EnvelopeShape
+{
+    linear,
+    exponential,
+};
+
+/*
+  The length of each stage in seconds and the sustain level. A stage with
+  length 0 is skipped, so attack = decay = release = 0 with sustain = 1
+  simply turns the sound on and off.
+ */
+struct EnvelopeSettings
+{
+    double attack = 0.01;
+    double decay = 0.1;
+    double sustain = 1.0;
+    double release = 0.01;
+    EnvelopeShape shape = EnvelopeShape::linear;
+};
+
+/*
+  An ADSR envelope that renders a whole block at a time.
+
+  Every stage is a segment that goes from one level to another in a known
+  number of samples. Rather than checking after each sample whether the
+  stage is finished, render() works out how many samples remain in the
+  current segment and fills that part of the block in a single loop:
+
+  - A linear segment is level + (i + 1) * step. Each sample is computed on
+    its own, so this loop is vectorized.
+  - An exponential segment moves towards a target that lies a little bit
+    past the end level, like an analog RC circuit. The distance to that
+    target shrinks by the same factor every sample. The factor is chosen
+    so that the curve hits the end level after exactly the right number of
+    samples.
+  - Sustain and idle are constant, so that's just a fill.
+
+  The segment lengths are computed from the settings when the note starts
+  or is released, so changing the settings does not affect notes that are
+  already in that stage.
+ */
+class Envelope
+{
+public:
+    enum class Stage : uint8_t
+    {
+        idle,
+        attack,
+        decay,
+        sustain,
+        release,
+    };
+
+    void reset();
+
+    void noteOn(const EnvelopeSettings& settings, double sampleRate);
+    void noteOff(const EnvelopeSettings& settings, double sampleRate);
+
+    /*
+      Writes the envelope levels for the next `sampleCount` samples into
+      `output` and moves the envelope ahead by that many samples.
+     */
+    void render(float* output, int sampleCount);
+
+    bool isIdle() const { return stage == Stage::idle; }
+    float getLevel() const { return level; }
+
+private:
+    void startSegment(Stage newStage, float end, int length);
+    void nextStage();
+
+    Stage stage = Stage::idle;
+    EnvelopeShape shape = EnvelopeShape::linear;
+
+    float level = 0.0f;    // current output level
+    float end = 0.0f;      // level at the end of this segment
+    float step = 0.0f;     // linear: change per sample
+    float target = 0.0f;   // exponential: the level being approached
+    float factor = 1.0f;   // exponential: how the distance to it shrinks
+    int remaining = 0;     // samples left in this segment
+
+    // Copied from the settings in noteOn().
+    int decayLength = 0;
+    float sustainLevel = 1.0f;
+};
@@ -0,0 +1,236 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+/*
+  The filtered noise and explosion generators from explosions.markdown.
+
+  These are the same as in the recipe, except that the seed for the random
+  generator is passed in rather than taken from the current time, so that
+  the same seed always gives the same sound.
+
+  Besides the recipe's operator() that makes one sample, both also have a
+  render() that fills a whole block. The sound is a series of straight
+  lines: the value moves towards the target by the same amount every
+  sample until it gets there and turns around. Instead of checking every
+  sample whether it has reached the target, render() works out how many
+  samples that takes and fills those with a ramp. Each sample of the ramp
+  is computed from the start of the line, so the loop vectorizes.
+
+  The only difference with operator() is the rounding: operator() adds the
+  slope to the value over and over, and render() multiplies it. Very rarely
+  that moves a turning point by one sample.
+ */
+
+/*
+  Returns the smallest k >= 1 for which direction * (start + k * step) is at
+  least `target`, or `limit` if that is further away. This is the same test
+  that the per-sample generators do, so the answer is first estimated and
+  then corrected for rounding.
+ */
+inline int samplesUntilTarget(float start, float step, float direction, float target, int limit)
+{
+    const float speed = direction * step;
+    if (!(speed > 0.0f)) {
+        return limit;  // never gets there
+    }
+
+    auto reached = [&](int k) { return direction * (start + float(k) * step) >= target; };
+
+    const double estimate = std::ceil((double(target) - double(direction * start)) / double(speed));
+    int k = int(std::min(std::max(estimate, 1.0), double(limit)));
+    while (k > 1 && reached(k - 1)) {
+        k -= 1;
+    }
+    while (k < limit && !reached(k)) {
+        k += 1;
+    }
+    return k;
+}
+
+/*
+  Writes start + step, start + 2*step, and so on.
+ */
+inline void renderRamp(float* output, int sampleCount, float start, float step)
+{
+    for (int i = 0; i < sampleCount; ++i) {
+        output[i] = start + float(i + 1) * step;
+    }
+}
+
+struct FilteredNoise
+{
+    explicit FilteredNoise(uint32_t seed) : seed(seed)
+    {
+        target = random();
+        direction = 1.0f;
+        value = 0.0f;
+        slope = 0.0f;
+    }
+
+    void setCutoff(float frequency, float sampleRate)
+    {
+        slope = 3.0f * frequency / sampleRate;
+    }
+
+    float operator()()
+    {
+        value += direction * slope;
+
+        // Time to reverse direction?
+        if (value * direction >= target) {
+            value = target * direction;
+            direction = -direction;
+            target = random();
+        }
+
+        return value;
+    }
+
+    void render(float* output, int sampleCount)
+    {
+        while (sampleCount > 0) {
+            const float step = direction * slope;
+            const int k = samplesUntilTarget(value, step, direction, target, sampleCount + 1);
+
+            if (k > sampleCount) {
+                renderRamp(output, sampleCount, value, step);
+                value += float(sampleCount) * step;
+                return;
+            }
+
+            renderRamp(output, k - 1, value, step);
+            value = target * direction;
+            output[k - 1] = value;
+            direction = -direction;
+            target = random();
+
+            output += k;
+            sampleCount -= k;
+        }
+    }
+
+private:
+    float random()
+    {
+        // Generate a pseudorandom number in the interval [0, 1).
+        seed = seed * 196314165 + 907633515;
+        return float((seed >> 8) & 0xFFFFFF) / 16777216.0f;
+    }
+
+    uint32_t seed;    // for the random generator
+    float value;      // current value
+    float slope;      // speed by which the value changes
+    float target;     // destination value (always positive)
+    float direction;  // going up (1.0) or down (-1.0)
+};
+
+struct Explosion
+{
+    explicit Explosion(uint32_t seed) : seed(seed)
+    {
+        target = random();
+        direction = 1.0f;
+        value = 0.0f;
+        slope = 0.0f;
+        slopeDecrement = 0.0f;
+        slopeEnd = 0.0f;
+    }
+
+    void start(float sampleRate)
+    {
+        slopeDecrement = (random() + 0.5f) / sampleRate;
+        slope = slopeDecrement * 250.0f + random() * 250.0f / sampleRate;
+        slopeEnd = 20.0f / sampleRate;
+    }
+
+    float operator()()
+    {
+        // Gently ramp back to the center when done.
+        if (slope < slopeEnd) {
+            if (direction * value >= 0.0f) {  // finished?
+                return 0.0f;
+            } else {
+                value += direction * slopeEnd / 4.0f;
+                return value;
+            }
+        }
+
+        value += direction * slope;
+
+        // Time to reverse direction?
+        if (value * direction >= target) {
+            value = target * direction;
+            direction = -direction;
+            target = random();
+            slope -= slopeDecrement;
+        }
+
+        return value;
+    }
+
+    void render(float* output, int sampleCount)
+    {
+        // The slope only changes when the direction reverses, so the check
+        // whether the explosion is done only needs to happen at that point.
+        while (sampleCount > 0 && slope >= slopeEnd) {
+            const float step = direction * slope;
+            const int k = samplesUntilTarget(value, step, direction, target, sampleCount + 1);
+
+            if (k > sampleCount) {
+                renderRamp(output, sampleCount, value, step);
+                value += float(sampleCount) * step;
+                return;
+            }
+
+            renderRamp(output, k - 1, value, step);
+            value = target * direction;
+            output[k - 1] = value;
+            direction = -direction;
+            target = random();
+            slope -= slopeDecrement;
+
+            output += k;
+            sampleCount -= k;
+        }
+
+        if (sampleCount <= 0) {
+            return;
+        }
+
+        // Gently ramp back to the center, then stay silent.
+        if (direction * value < 0.0f) {
+            const float step = direction * slopeEnd / 4.0f;
+            const int k = samplesUntilTarget(value, step, direction, 0.0f, sampleCount);
+            renderRamp(output, k, value, step);
+            value += float(k) * step;
+            output += k;
+            sampleCount -= k;
+        }
+        std::fill(output, output + sampleCount, 0.0f);
+    }
+
+    bool isFinished() const
+    {
+        return slope < slopeEnd && direction * value >= 0.0f;
+    }
+
+private:
+    float random()
+    {
+        // Generate a pseudorandom number in the interval [0, 1).
+        seed = seed * 196314165 + 907633515;
+        return float((seed >> 8) & 0xFFFFFF) / 16777216.0f;
+    }
+
+    uint32_t seed;    // for the random generator
+    float value;      // current value
+    float slope;      // speed by which the value changes
+    float target;     // destination value (always positive)
+    float direction;  // going up (1.0) or down (-1.0)
+
+    float slopeDecrement;  // speed of filter sweep
+    float slopeEnd;        // when to stop
+};
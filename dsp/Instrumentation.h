@@ -0,0 +1,81 @@
+#pragma once
+
+// Uncomment the define to measure how long processBlock() takes and show the
+// results in the editor. When it is commented out, none of the measuring code
+// gets compiled, so it costs nothing.
+//#define ENABLE_INSTRUMENTATION
+
+#ifdef ENABLE_INSTRUMENTATION
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+/*
+  Timings for one call to processBlock(). All times are in microseconds.
+ */
+struct BlockStats
+{
+    int sampleCount = 0;
+    int segmentCount = 0;       // how many times processSamples() was called
+    int voiceCount = 0;         // voices playing at the end of the block
+    double totalTime = 0.0;
+    double renderTime = 0.0;    // total of all segments
+    double maxSegmentTime = 0.0;
+    double limiterTime = 0.0;
+
+    // How much of the time available for this block was used. Anything
+    // close to 1.0 means the host is at risk of an audio dropout.
+    double budgetUsed = 0.0;
+};
+
+/*
+  Passes BlockStats from the audio thread to the editor.
+
+  This is a single-producer, single-consumer ring buffer: the audio thread
+  only writes `head` and the message thread only writes `tail`, so neither
+  ever waits for the other. When the editor isn't open, nobody reads the
+  stats and the audio thread simply drops them once the buffer is full.
+ */
+class Instrumentation
+{
+public:
+    static constexpr int capacity = 256;  // must be a power of two
+
+    typedef std::chrono::steady_clock Clock;
+
+    static double microsecondsSince(Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+    }
+
+    // Called on the audio thread.
+    void push(const BlockStats& stats)
+    {
+        const uint32_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) == capacity) {
+            return;  // full
+        }
+        buffer[h & (capacity - 1)] = stats;
+        head.store(h + 1, std::memory_order_release);
+    }
+
+    // Called on the message thread.
+    bool pop(BlockStats& stats)
+    {
+        const uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire)) {
+            return false;  // empty
+        }
+        stats = buffer[t & (capacity - 1)];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    BlockStats buffer[capacity];
+    std::atomic<uint32_t> head { 0 };
+    std::atomic<uint32_t> tail { 0 };
+};
+
+#endif  // ENABLE_INSTRUMENTATION
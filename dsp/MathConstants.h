@@ -0,0 +1,8 @@
+#pragma once
+
+// The constants that the recipes use everywhere. These are constexpr, so
+// every file that includes this gets its own copy, without any linker issues.
+constexpr double PI         = 3.14159265358979323846264338327950288;
+constexpr double TWO_PI     = 6.28318530717958647692528676655900576;
+constexpr double INV_TWO_PI = 0.159154943091895335768883763372514362;
+constexpr double SQRT2      = 1.41421356237309504880168872420969808;
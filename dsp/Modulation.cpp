@@ -0,0 +1,84 @@
+#include "Modulation.h"
+#include "MathConstants.h"
+#include "SIMD.h"
+
+#include <algorithm>
+#include <cmath>
+
+float LFO::next(const LFOSettings& settings, double seconds)
+{
+    phase += double(settings.rate) * seconds;
+    phase -= std::floor(phase);
+
+    const float p = float(phase);
+    switch (settings.shape) {
+        case LFOShape::sine:
+            return float(std::sin(TWO_PI * phase));
+        case LFOShape::triangle:
+            return (p < 0.5f) ? 4.0f * p - 1.0f : 3.0f - 4.0f * p;
+        case LFOShape::saw:
+            return 2.0f * p - 1.0f;
+        case LFOShape::square:
+            return (p < 0.5f) ? 1.0f : -1.0f;
+    }
+    return 0.0f;
+}
+
+void ModMatrix::prepare(int maxVoices)
+{
+    stride = (maxVoices + 3) & ~3;
+    sources.assign(size_t(numSources) * stride, 0.0f);
+    destinations.assign(size_t(numDestinations) * stride, 0.0f);
+    std::fill(sources.begin(), sources.begin() + stride, 1.0f);
+}
+
+void ModMatrix::setRoutes(const ModulationSettings& settings)
+{
+    routeCount = 0;
+    std::fill(routed, routed + numDestinations, false);
+
+    // Routes that do nothing are left out, so they cost nothing.
+    const int count = std::min(std::max(settings.routeCount, 0), int(ModulationSettings::maxRoutes));
+    for (int i = 0; i < count; ++i) {
+        const ModRoute& route = settings.routes[i];
+        if (route.amount != 0.0f && int(route.source) < numSources && int(route.via) < numSources
+                && int(route.destination) < numDestinations) {
+            routes[routeCount++] = route;
+            routed[int(route.destination)] = true;
+        }
+    }
+}
+
+void ModMatrix::evaluate(int voiceCount)
+{
+    // The arrays have room for a multiple of four voices, so the loops can
+    // go past the last voice without needing a scalar tail. The results for
+    // those extra slots are never used.
+    const int count = std::min((voiceCount + 3) & ~3, stride);
+    std::fill(destinations.begin(), destinations.end(), 0.0f);
+
+    for (int r = 0; r < routeCount; ++r) {
+        const float* source = sources.data() + int(routes[r].source) * stride;
+        const float* via = sources.data() + int(routes[r].via) * stride;
+        float* destination = destinations.data() + int(routes[r].destination) * stride;
+        const float amount = routes[r].amount;
+
+        #if defined(DSP_X86)
+        const __m128 a = _mm_set1_ps(amount);
+        for (int v = 0; v < count; v += 4) {
+            const __m128 x = _mm_mul_ps(_mm_loadu_ps(source + v), _mm_loadu_ps(via + v));
+            _mm_storeu_ps(destination + v, _mm_add_ps(_mm_loadu_ps(destination + v), _mm_mul_ps(a, x)));
+        }
+        #elif defined(DSP_NEON)
+        const float32x4_t a = vdupq_n_f32(amount);
+        for (int v = 0; v < count; v += 4) {
+            const float32x4_t x = vmulq_f32(vld1q_f32(source + v), vld1q_f32(via + v));
+            vst1q_f32(destination + v, vaddq_f32(vld1q_f32(destination + v), vmulq_f32(a, x)));
+        }
+        #else
+        for (int v = 0; v < count; ++v) {
+            destination[v] += amount * (source[v] * via[v]);
+        }
+        #endif
+    }
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/*
+  LFOs and a modulation matrix that runs at control rate.
+
+  A route takes a source, such as an LFO or the mod wheel, multiplies it by
+  an amount, and adds it to a destination, such as the pitch. The routes are
+  not evaluated for every sample but once per control tick (every 32
+  samples by default), for all voices at the same time. Each source and
+  destination is a flat array with one float per voice, so a route is a
+  single loop of multiply-adds over the voices, done four at a time with
+  SIMD. A patch with many routes costs a few of these short loops per tick,
+  not a few operations per route for every sample.
+
+  The synth takes the result of each tick and spreads it out over the next
+  tick: the amplitude becomes a linear ramp, and the pitch and noise cutoff
+  change in small steps. The oscillator phase is continuous, so a stepped
+  pitch does not click.
+ */
+
+enum class LFOShape
+{
+    sine,
+    triangle,
+    saw,
+    square,
+};
+
+struct LFOSettings
+{
+    float rate = 5.0f;    // in Hz
+    LFOShape shape = LFOShape::sine;
+};
+
+/*
+  Every source is between 0 and 1, except the LFOs, which go from -1 to 1.
+  `none` is always 1. It's used as the `via` of a route that isn't scaled by
+  a second source.
+ */
+enum class ModSource : uint8_t
+{
+    none,
+    lfo1,
+    lfo2,
+    modWheel,
+    pressure,   // channel aftertouch
+    velocity,
+};
+
+// The units of the amount of a route, per destination.
+enum class ModDestination : uint8_t
+{
+    pitch,      // semitones
+    amplitude,  // change in gain, where 1 doubles it and -1 silences it
+    cutoff,     // octaves, for the filtered noise
+};
+
+/*
+  destination += amount * source * via. With `via` set to the mod wheel, an
+  LFO to the pitch gives the usual vibrato that the mod wheel fades in.
+ */
+struct ModRoute
+{
+    ModSource source = ModSource::lfo1;
+    ModSource via = ModSource::none;
+    ModDestination destination = ModDestination::pitch;
+    float amount = 0.0f;
+};
+
+struct ModulationSettings
+{
+    static constexpr int numLFOs = 2;
+    static constexpr int maxRoutes = 16;
+
+    LFOSettings lfo[numLFOs];
+    ModRoute routes[maxRoutes];
+    int routeCount = 0;
+
+    // Samples per control tick, from 8 to 256. Each tick splits the render
+    // of every voice, so longer ticks are cheaper but the modulation gets
+    // coarser. Even 256 samples is over 180 ticks per second at 48 kHz.
+    int tickLength = 32;
+};
+
+/*
+  The LFOs are shared by all voices and run freely, so they don't restart
+  on every note. Each one only computes one value per control tick.
+ */
+class LFO
+{
+public:
+    void reset() { phase = 0.0; }
+
+    // Moves ahead by `seconds` and returns the value at the new position.
+    float next(const LFOSettings& settings, double seconds);
+
+private:
+    double phase = 0.0;   // 0 to 1
+};
+
+class ModMatrix
+{
+public:
+    static constexpr int numSources = int(ModSource::velocity) + 1;
+    static constexpr int numDestinations = int(ModDestination::cutoff) + 1;
+
+    // Allocates the arrays for this many voices.
+    void prepare(int maxVoices);
+
+    void setRoutes(const ModulationSettings& settings);
+
+    bool hasRoutes() const { return routeCount > 0; }
+
+    // True if any route goes to this destination.
+    bool isRouted(ModDestination destination) const
+    {
+        return routed[int(destination)];
+    }
+
+    // One value per voice. Fill these in before evaluate(). The `none`
+    // source is already filled with ones.
+    float* source(ModSource source)
+    {
+        return sources.data() + int(source) * stride;
+    }
+
+    const float* destination(ModDestination destination) const
+    {
+        return destinations.data() + int(destination) * stride;
+    }
+
+    // Sums up all the routes for the first `voiceCount` voices.
+    void evaluate(int voiceCount);
+
+private:
+    int stride = 0;     // the voice count, rounded up to a multiple of 4
+    std::vector<float> sources;
+    std::vector<float> destinations;
+
+    int routeCount = 0;
+    ModRoute routes[ModulationSettings::maxRoutes];
+    bool routed[numDestinations] = { };
+};
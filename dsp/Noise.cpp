@@ -0,0 +1,224 @@
+#include "Noise.h"
+#include "SIMD.h"
+
+#include <cstring>
+
+namespace {
+
+constexpr int lanes = 8;
+
+constexpr uint32_t LCG_A = 196314165u;
+constexpr uint32_t LCG_C = 907633515u;
+
+// Doing n steps of the LCG is the same as doing a single step with these
+// constants: seed = seed * lcgJumpMul(n) + lcgJumpAdd(n).
+constexpr uint32_t lcgJumpMul(int n)
+{
+    return (n == 0) ? 1u : LCG_A * lcgJumpMul(n - 1);
+}
+
+constexpr uint32_t lcgJumpAdd(int n)
+{
+    return (n == 0) ? 0u : lcgJumpAdd(n - 1) * LCG_A + LCG_C;
+}
+
+DSP_INLINE float lcgToFloat(uint32_t x)
+{
+    uint32_t bits = 0x3F800000u | (x >> 9);
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f * 2.0f - 3.0f;
+}
+
+DSP_INLINE uint32_t lfsrStep(uint32_t x)
+{
+    // Same as the recipe, but without the branch: the mask is all ones if
+    // the lowest bit is set and all zeros otherwise.
+    return (x >> 1) ^ ((0u - (x & 1u)) & 0x80000062u);
+}
+
+DSP_INLINE float lfsrToFloat(uint32_t x)
+{
+    return (float(int32_t((x >> 7) & 0x1FFFFFFu)) - 16777216.0f) * (1.0f / 16777216.0f);
+}
+
+/*
+  In both loops the full groups of eight stop one sample early, so that the
+  last group always has between 1 and 8 samples in it. The lane that wrote
+  the very last sample then holds the new seed.
+ */
+
+DSP_INLINE void whiteNoiseLanes(float* output, int sampleCount, uint32_t& seed)
+{
+    if (sampleCount <= 0) {
+        return;
+    }
+
+    uint32_t state[lanes];
+    state[0] = seed * LCG_A + LCG_C;
+    for (int k = 1; k < lanes; ++k) {
+        state[k] = state[k - 1] * LCG_A + LCG_C;
+    }
+
+    const uint32_t mul = lcgJumpMul(lanes);
+    const uint32_t add = lcgJumpAdd(lanes);
+
+    int i = 0;
+    for (; i + lanes < sampleCount; i += lanes) {
+        for (int k = 0; k < lanes; ++k) {
+            output[i + k] = lcgToFloat(state[k]);
+            state[k] = state[k] * mul + add;
+        }
+    }
+
+    const int remaining = sampleCount - i;
+    for (int k = 0; k < remaining; ++k) {
+        output[i + k] = lcgToFloat(state[k]);
+    }
+    seed = state[remaining - 1];
+}
+
+/*
+  The LFSR is linear, and within eight steps the feedback only depends on
+  the lowest eight bits of the seed. So eight steps can be done in one go
+  by shifting right by eight and XOR-ing with a value from this table.
+ */
+struct LFSRJumpTable
+{
+    LFSRJumpTable()
+    {
+        for (uint32_t bits = 0; bits < 256; ++bits) {
+            uint32_t x = bits;
+            for (int step = 0; step < lanes; ++step) {
+                x = lfsrStep(x);
+            }
+            table[bits] = x;
+        }
+    }
+
+    uint32_t table[256];
+};
+
+const LFSRJumpTable lfsrJump;
+
+void lfsrNoiseLanes(float* output, int sampleCount, uint32_t& seed)
+{
+    if (sampleCount <= 0) {
+        return;
+    }
+
+    uint32_t state[lanes];
+    state[0] = lfsrStep(seed);
+    for (int k = 1; k < lanes; ++k) {
+        state[k] = lfsrStep(state[k - 1]);
+    }
+
+    int i = 0;
+    for (; i + lanes < sampleCount; i += lanes) {
+        for (int k = 0; k < lanes; ++k) {
+            uint32_t x = state[k];
+            output[i + k] = lfsrToFloat(x);
+            state[k] = (x >> 8) ^ lfsrJump.table[x & 0xFF];
+        }
+    }
+
+    const int remaining = sampleCount - i;
+    for (int k = 0; k < remaining; ++k) {
+        output[i + k] = lfsrToFloat(state[k]);
+    }
+    seed = state[remaining - 1];
+}
+
+void whiteNoiseDefault(float* output, int sampleCount, uint32_t& seed)
+{
+    whiteNoiseLanes(output, sampleCount, seed);
+}
+
+#ifdef DSP_X86
+
+DSP_TARGET_AVX2 void whiteNoiseAVX2(float* output, int sampleCount, uint32_t& seed)
+{
+    whiteNoiseLanes(output, sampleCount, seed);
+}
+
+const bool useAVX2 = cpuHasAVX2();
+
+#endif  // DSP_X86
+
+/*
+  The LFSR as a polynomial: bit i of the state is the coefficient of
+  x^(31 - i). Shifting right multiplies by x, and the bit that falls off the
+  end is x^32, which the taps replace by x^30 + x^26 + x^25 + 1. In the
+  usual bit order (bit i is x^i) that is the polynomial below.
+ */
+constexpr uint32_t LFSR_POLY = 0x46000001u;
+
+uint32_t reverseBits(uint32_t x)
+{
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+    x = ((x >> 8) & 0x00FF00FFu) | ((x & 0x00FF00FFu) << 8);
+    return (x >> 16) | (x << 16);
+}
+
+// a * b modulo x^32 + LFSR_POLY, with coefficients in GF(2).
+uint32_t multiplyModPoly(uint32_t a, uint32_t b)
+{
+    uint32_t result = 0;
+    for (int bit = 0; bit < 32; ++bit) {
+        result ^= (0u - ((b >> bit) & 1u)) & a;
+        a = (a << 1) ^ ((0u - (a >> 31)) & LFSR_POLY);
+    }
+    return result;
+}
+
+}  // namespace
+
+void renderWhiteNoise(float* output, int sampleCount, uint32_t& seed)
+{
+    #ifdef DSP_X86
+    if (useAVX2) {
+        whiteNoiseAVX2(output, sampleCount, seed);
+        return;
+    }
+    #endif
+    whiteNoiseDefault(output, sampleCount, seed);
+}
+
+void renderLFSRNoise(float* output, int sampleCount, uint32_t& seed)
+{
+    lfsrNoiseLanes(output, sampleCount, seed);
+}
+
+uint32_t skipWhiteNoise(uint32_t seed, uint64_t sampleCount)
+{
+    // Each bit of the count applies the jump for that power of two, and the
+    // jump for the next bit is the current one done twice:
+    // (x * mul + add) * mul + add = x * mul^2 + (add * mul + add).
+    uint32_t mul = LCG_A;
+    uint32_t add = LCG_C;
+    while (sampleCount > 0) {
+        if (sampleCount & 1) {
+            seed = seed * mul + add;
+        }
+        add = add * mul + add;
+        mul = mul * mul;
+        sampleCount >>= 1;
+    }
+    return seed;
+}
+
+uint32_t skipLFSRNoise(uint32_t seed, uint64_t sampleCount)
+{
+    uint32_t power = 1u;     // x^0
+    uint32_t square = 2u;    // x^1
+    while (sampleCount > 0) {
+        if (sampleCount & 1) {
+            power = multiplyModPoly(power, square);
+        }
+        square = multiplyModPoly(square, square);
+        sampleCount >>= 1;
+    }
+    return reverseBits(multiplyModPoly(reverseBits(seed), power));
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+  Block-based noise generators from the white noise and LFSR recipes.
+
+  Both functions fill the buffer with noise in the range [-1, 1) and update
+  `seed` as they go, exactly like calling the recipe's generator once per
+  sample would. Pass the same seed variable on the next call to continue the
+  sequence. Because of this, the output does not depend on how the samples
+  are split into blocks.
+
+  The speed comes from running eight copies of the generator side-by-side.
+  Lane k produces samples k, k + 8, k + 16, and so on, so each lane jumps
+  ahead by eight steps at a time. For the LCG that jump is a single
+  multiply-add with different constants, and all eight lanes are computed
+  with one SIMD instruction. The LFSR does its jump with a table lookup.
+
+  Note that the LFSR lanes cannot simply be independent streams: LFSR noise
+  gets its darker sound from each sample being related to the previous one.
+ */
+
+/*
+  White noise using the 32-bit LCG with the constants from Hal Chamberlin.
+  The float is made by putting the top 23 bits of the random number into the
+  mantissa of 0x3F800000 (1.0f), which gives a number in [1, 2).
+ */
+void renderWhiteNoise(float* output, int sampleCount, uint32_t& seed);
+
+/*
+  Noise from the maximal-length 32-bit Galois LFSR with taps 0x80000062.
+  The seed must not be 0.
+ */
+void renderLFSRNoise(float* output, int sampleCount, uint32_t& seed);
+
+/*
+  These return the seed that the generators above have after `sampleCount`
+  samples, without making the samples. This takes O(log n) time, so a long
+  render can be split into chunks that each start at their own position in
+  the sequence, and together they give exactly the same samples as one
+  long render would.
+
+  For the LCG, n steps are the same as one step with a different multiplier
+  and increment, which are found by repeated squaring of the step itself.
+  An LFSR step is the same as multiplying by x modulo the LFSR's feedback
+  polynomial, so n steps is a multiplication by x^n, and x^n is also found
+  by repeated squaring.
+ */
+uint32_t skipWhiteNoise(uint32_t seed, uint64_t sampleCount);
+uint32_t skipLFSRNoise(uint32_t seed, uint64_t sampleCount);
@@ -0,0 +1,214 @@
+#include "Oversampler.h"
+#include "MathConstants.h"
+#include "SIMD.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+constexpr double KAISER_BETA = 8.0;
+
+// Modified Bessel function of the first kind, needed for the Kaiser window.
+double besselI0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 50; ++k) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < 1e-12 * sum) {
+            break;
+        }
+    }
+    return sum;
+}
+
+/*
+  Every output sample is 0.5 times an odd input sample plus the even input
+  samples around it times the taps. The SIMD versions make two vectors of
+  output samples at once, and the inner loop over the taps keeps both in
+  registers the whole time. Two independent sums keep the multiply-adds
+  from waiting on each other.
+ */
+
+void decimateScalar(const float* even, const float* odd, const float* taps, int tapCount,
+                    float* output, int start, int outputCount)
+{
+    for (int m = start; m < outputCount; ++m) {
+        float sum = 0.5f * odd[m];
+        for (int i = 0; i < tapCount; ++i) {
+            sum += taps[i] * even[m + i];
+        }
+        output[m] = sum;
+    }
+}
+
+#ifdef DSP_X86
+
+void decimateSSE2(const float* even, const float* odd, const float* taps, int tapCount,
+                  float* output, int outputCount)
+{
+    const __m128 half = _mm_set1_ps(0.5f);
+
+    int m = 0;
+    for (; m + 8 <= outputCount; m += 8) {
+        __m128 sum0 = _mm_mul_ps(half, _mm_loadu_ps(odd + m));
+        __m128 sum1 = _mm_mul_ps(half, _mm_loadu_ps(odd + m + 4));
+        for (int i = 0; i < tapCount; ++i) {
+            const __m128 tap = _mm_set1_ps(taps[i]);
+            sum0 = _mm_add_ps(sum0, _mm_mul_ps(tap, _mm_loadu_ps(even + m + i)));
+            sum1 = _mm_add_ps(sum1, _mm_mul_ps(tap, _mm_loadu_ps(even + m + i + 4)));
+        }
+        _mm_storeu_ps(output + m, sum0);
+        _mm_storeu_ps(output + m + 4, sum1);
+    }
+    decimateScalar(even, odd, taps, tapCount, output, m, outputCount);
+}
+
+DSP_TARGET_AVX2 void decimateAVX2(const float* even, const float* odd, const float* taps, int tapCount,
+                                  float* output, int outputCount)
+{
+    const __m256 half = _mm256_set1_ps(0.5f);
+
+    int m = 0;
+    for (; m + 16 <= outputCount; m += 16) {
+        __m256 sum0 = _mm256_mul_ps(half, _mm256_loadu_ps(odd + m));
+        __m256 sum1 = _mm256_mul_ps(half, _mm256_loadu_ps(odd + m + 8));
+        for (int i = 0; i < tapCount; ++i) {
+            const __m256 tap = _mm256_set1_ps(taps[i]);
+            sum0 = _mm256_fmadd_ps(tap, _mm256_loadu_ps(even + m + i), sum0);
+            sum1 = _mm256_fmadd_ps(tap, _mm256_loadu_ps(even + m + i + 8), sum1);
+        }
+        _mm256_storeu_ps(output + m, sum0);
+        _mm256_storeu_ps(output + m + 8, sum1);
+    }
+    decimateScalar(even, odd, taps, tapCount, output, m, outputCount);
+}
+
+const bool useAVX2 = cpuHasAVX2();
+
+#endif  // DSP_X86
+
+#ifdef DSP_NEON
+
+void decimateNEON(const float* even, const float* odd, const float* taps, int tapCount,
+                  float* output, int outputCount)
+{
+    int m = 0;
+    for (; m + 8 <= outputCount; m += 8) {
+        float32x4_t sum0 = vmulq_n_f32(vld1q_f32(odd + m), 0.5f);
+        float32x4_t sum1 = vmulq_n_f32(vld1q_f32(odd + m + 4), 0.5f);
+        for (int i = 0; i < tapCount; ++i) {
+            sum0 = vmlaq_n_f32(sum0, vld1q_f32(even + m + i), taps[i]);
+            sum1 = vmlaq_n_f32(sum1, vld1q_f32(even + m + i + 4), taps[i]);
+        }
+        vst1q_f32(output + m, sum0);
+        vst1q_f32(output + m + 4, sum1);
+    }
+    decimateScalar(even, odd, taps, tapCount, output, m, outputCount);
+}
+
+#endif  // DSP_NEON
+
+void decimate(const float* even, const float* odd, const float* taps, int tapCount,
+              float* output, int outputCount)
+{
+    #if defined(DSP_X86)
+    if (useAVX2) {
+        decimateAVX2(even, odd, taps, tapCount, output, outputCount);
+        return;
+    }
+    decimateSSE2(even, odd, taps, tapCount, output, outputCount);
+    #elif defined(DSP_NEON)
+    decimateNEON(even, odd, taps, tapCount, output, outputCount);
+    #else
+    decimateScalar(even, odd, taps, tapCount, output, 0, outputCount);
+    #endif
+}
+
+}  // namespace
+
+HalfBandDecimator::HalfBandDecimator(int halfLength_)
+    : halfLength(halfLength_), historyLength(2 * halfLength_ - 1)
+{
+    // The full filter has N = 4L - 1 taps with the center at 2L - 1. The
+    // taps at even positions are the nonzero ones that get used here.
+    const int N = 4 * halfLength - 1;
+    const int center = 2 * halfLength - 1;
+
+    taps.resize(2 * halfLength);
+    double sum = 0.0;
+    for (int i = 0; i < 2 * halfLength; ++i) {
+        const int n = 2 * i;
+        const double x = double(n - center) / 2.0;
+        const double sinc = std::sin(PI * x) / (PI * x);
+        const double r = 2.0 * n / double(N - 1) - 1.0;
+        const double window = besselI0(KAISER_BETA * std::sqrt(1.0 - r * r)) / besselI0(KAISER_BETA);
+        taps[i] = float(0.5 * sinc * window);
+        sum += 0.5 * sinc * window;
+    }
+
+    // Together with the center tap of 0.5, the gain at DC must be exactly 1.
+    for (float& tap : taps) {
+        tap = float(tap * 0.5 / sum);
+    }
+}
+
+void HalfBandDecimator::prepare(int maxOutputSamples)
+{
+    even.assign(historyLength + maxOutputSamples, 0.0f);
+    odd.assign(historyLength + maxOutputSamples, 0.0f);
+}
+
+void HalfBandDecimator::reset()
+{
+    std::fill(even.begin(), even.end(), 0.0f);
+    std::fill(odd.begin(), odd.end(), 0.0f);
+}
+
+void HalfBandDecimator::process(const float* input, float* output, int outputCount)
+{
+    float* e = even.data();
+    float* o = odd.data();
+
+    for (int j = 0; j < outputCount; ++j) {
+        e[historyLength + j] = input[2 * j];
+        o[historyLength + j] = input[2 * j + 1];
+    }
+
+    // The center tap of output m is odd sample m + L - 1, counting from the
+    // start of the history.
+    decimate(e, o + halfLength - 1, taps.data(), int(taps.size()), output, outputCount);
+
+    std::memmove(e, e + outputCount, historyLength * sizeof(float));
+    std::memmove(o, o + outputCount, historyLength * sizeof(float));
+}
+
+Oversampler::Oversampler() : stage4x(6), stage2x(12)
+{
+}
+
+void Oversampler::prepare(int maxOutputSamples)
+{
+    stage4x.prepare(2 * maxOutputSamples);
+    stage2x.prepare(maxOutputSamples);
+    intermediate.assign(2 * maxOutputSamples, 0.0f);
+}
+
+void Oversampler::reset()
+{
+    stage4x.reset();
+    stage2x.reset();
+}
+
+void Oversampler::decimate(const float* input, float* output, int outputCount, int factor)
+{
+    if (factor == 4) {
+        stage4x.process(input, intermediate.data(), 2 * outputCount);
+        stage2x.process(intermediate.data(), output, outputCount);
+    } else {
+        stage2x.process(input, output, outputCount);
+    }
+}
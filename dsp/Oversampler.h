@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+
+/*
+  Halves the sample rate with a half-band FIR low-pass filter.
+
+  A half-band filter has its cutoff at a quarter of the sample rate, which
+  makes every other coefficient zero, apart from the one in the middle,
+  which is always 0.5. After decimating by two, the even input samples only
+  ever meet the nonzero coefficients and the odd input samples only meet
+  the center tap. So the input is split into its even and odd samples (the
+  two "phases" of the polyphase filter) and every output sample costs only
+  `2 * halfLength` multiply-adds. The filter never computes the outputs
+  that would be thrown away.
+
+  The filter has 4 * halfLength - 1 taps and uses a Kaiser window. Its
+  passband goes up to about 0.2 times the input rate. The stopband starts
+  at 0.3 times the input rate and its attenuation is around 80 dB.
+ */
+class HalfBandDecimator
+{
+public:
+    explicit HalfBandDecimator(int halfLength);
+
+    /*
+      Allocates the buffers for up to `maxOutputSamples` output samples
+      per call. Call this from prepareToPlay().
+     */
+    void prepare(int maxOutputSamples);
+
+    void reset();
+
+    /*
+      Reads 2 * outputCount samples from `input` and writes outputCount
+      samples to `output`. The input and output may be the same buffer.
+     */
+    void process(const float* input, float* output, int outputCount);
+
+private:
+    int halfLength;
+    int historyLength;
+    std::vector<float> taps;   // coefficients for the even samples
+    std::vector<float> even;   // history followed by the new even samples
+    std::vector<float> odd;    // history followed by the new odd samples
+};
+
+/*
+  Turns audio that was rendered at 2x or 4x the sample rate back into audio
+  at the normal rate. For 4x, a short filter first goes down to 2x. It can
+  be short because everything it has to remove lies far above the audible
+  range. The second filter is longer and does the real work.
+ */
+class Oversampler
+{
+public:
+    Oversampler();
+
+    void prepare(int maxOutputSamples);
+    void reset();
+
+    /*
+      Reads `factor * outputCount` samples from `input` and writes
+      `outputCount` samples to `output`. `factor` must be 2 or 4.
+     */
+    void decimate(const float* input, float* output, int outputCount, int factor);
+
+private:
+    HalfBandDecimator stage4x;
+    HalfBandDecimator stage2x;
+    std::vector<float> intermediate;
+};
@@ -0,0 +1,63 @@
+#include "PitchTable.h"
+#include "MathConstants.h"
+#include "SIMD.h"
+
+void fastExp2(const float* input, float* output, int count)
+{
+    int i = 0;
+
+    // The same steps as the scalar version, in the same order, so that the
+    // results do not depend on which path was taken.
+    #if defined(DSP_X86)
+    const __m128 magic = _mm_set1_ps(12582912.0f);
+    const __m128i one = _mm_set1_epi32(0x3F800000);
+    for (; i + 4 <= count; i += 4) {
+        const __m128 x = _mm_loadu_ps(input + i);
+        const __m128 shifted = _mm_add_ps(x, magic);
+        const __m128 f = _mm_sub_ps(x, _mm_sub_ps(shifted, magic));
+        __m128 p = _mm_add_ps(_mm_mul_ps(f, _mm_set1_ps(0.00132187f)), _mm_set1_ps(0.00967170f));
+        p = _mm_add_ps(_mm_mul_ps(f, p), _mm_set1_ps(0.05550893f));
+        p = _mm_add_ps(_mm_mul_ps(f, p), _mm_set1_ps(0.24022238f));
+        p = _mm_add_ps(_mm_mul_ps(f, p), _mm_set1_ps(0.69314686f));
+        p = _mm_add_ps(_mm_mul_ps(f, p), _mm_set1_ps(1.0f));
+        const __m128i bits = _mm_add_epi32(_mm_slli_epi32(_mm_castps_si128(shifted), 23), one);
+        _mm_storeu_ps(output + i, _mm_mul_ps(p, _mm_castsi128_ps(bits)));
+    }
+    #elif defined(DSP_NEON)
+    const float32x4_t magic = vdupq_n_f32(12582912.0f);
+    const uint32x4_t one = vdupq_n_u32(0x3F800000);
+    for (; i + 4 <= count; i += 4) {
+        const float32x4_t x = vld1q_f32(input + i);
+        const float32x4_t shifted = vaddq_f32(x, magic);
+        const float32x4_t f = vsubq_f32(x, vsubq_f32(shifted, magic));
+        float32x4_t p = vaddq_f32(vmulq_f32(f, vdupq_n_f32(0.00132187f)), vdupq_n_f32(0.00967170f));
+        p = vaddq_f32(vmulq_f32(f, p), vdupq_n_f32(0.05550893f));
+        p = vaddq_f32(vmulq_f32(f, p), vdupq_n_f32(0.24022238f));
+        p = vaddq_f32(vmulq_f32(f, p), vdupq_n_f32(0.69314686f));
+        p = vaddq_f32(vmulq_f32(f, p), vdupq_n_f32(1.0f));
+        const uint32x4_t bits = vaddq_u32(vshlq_n_u32(vreinterpretq_u32_f32(shifted), 23), one);
+        vst1q_f32(output + i, vmulq_f32(p, vreinterpretq_f32_u32(bits)));
+    }
+    #endif
+
+    for (; i < count; ++i) {
+        output[i] = fastExp2(input[i]);
+    }
+}
+
+void PitchTable::prepare(double sampleRate_)
+{
+    if (sampleRate_ == sampleRate) {
+        return;
+    }
+    sampleRate = sampleRate_;
+
+    for (int note = 0; note < numNotes; ++note) {
+        noteFrequency[note] = 440.0 * std::exp2(double(note - 69) / 12.0);
+        noteIncrement[note] = noteFrequency[note] * TWO_PI / sampleRate;
+    }
+
+    for (int step = 0; step <= stepsPerSemitone; ++step) {
+        stepRatio[step] = std::exp2(double(step) / double(12 * stepsPerSemitone));
+    }
+}
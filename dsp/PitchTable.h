@@ -0,0 +1,105 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+/*
+  Fast approximation of 2^x, for pitch modulation that changes every sample
+  or every block, such as an LFO. The relative error is less than 2e-7, or
+  0.0003 cents, which is about as precise as a float gets.
+
+  The number is split into a whole part i and a fraction f between -0.5 and
+  0.5. A polynomial gives 2^f, and since 2^i is a power of two, it can be
+  made directly from the bits of a float. Only works for x between -126 and
+  126, which is plenty for pitch. This isn't checked, as the check would
+  stop the compiler from vectorizing loops that use it.
+ */
+inline float fastExp2(float x)
+{
+    // Adding 1.5 * 2^23 pushes the fraction out of the float, which rounds
+    // the number to the nearest integer and puts that integer in the lowest
+    // bits. This is a lot faster than converting to int and back. (It only
+    // works without -ffast-math, which would cancel out the two additions.)
+    const float shifted = x + 12582912.0f;
+    const float f = x - (shifted - 12582912.0f);
+
+    // Least-squares fit for the relative error on [-0.5, 0.5].
+    const float p = 1.0f + f * (0.69314686f + f * (0.24022238f + f * (0.05550893f
+                   + f * (0.00967170f + f * 0.00132187f))));
+
+    // Shifting the integer into the exponent bits of 1.0 gives 2^i. The
+    // rest of the bits of `shifted` fall off the end.
+    uint32_t bits;
+    std::memcpy(&bits, &shifted, sizeof(bits));
+    bits = (bits << 23) + 0x3F800000;
+    float scale;
+    std::memcpy(&scale, &bits, sizeof(scale));
+    return p * scale;
+}
+
+/*
+  Computes fastExp2() for a whole block of values, four at a time with SIMD.
+  The results are exactly the same as from the function above.
+ */
+void fastExp2(const float* input, float* output, int count);
+
+/*
+  Phase increments for all MIDI notes at a given sample rate.
+
+  Calculating the pitch of a note needs an exp2() and a division. That is
+  fine once per note on, but with pitch bend and modulation it has to happen
+  for every voice in every block. The table holds the increment for each
+  note, plus the ratios for steps of 1/64th of a semitone. The increment for
+  any pitch in between is then one lookup and a linear interpolation.
+
+  prepare() builds the tables, so call it when the sample rate changes.
+ */
+class PitchTable
+{
+public:
+    static constexpr int numNotes = 128;
+    static constexpr int stepsPerSemitone = 64;
+
+    void prepare(double sampleRate);
+
+    // The frequency in Hz of a MIDI note, where note 69 is A4 at 440 Hz.
+    double frequency(int note) const
+    {
+        return noteFrequency[clampNote(note)];
+    }
+
+    // The phase increment in radians per sample for a MIDI note.
+    double increment(int note) const
+    {
+        return noteIncrement[clampNote(note)];
+    }
+
+    /*
+      The phase increment in radians per sample for a pitch that is not a
+      whole note, such as 60.5 for a quarter tone above middle C. The error
+      of the interpolation is less than 0.0002 cents.
+     */
+    double increment(double pitch) const
+    {
+        pitch = std::fmin(std::fmax(pitch, 0.0), double(numNotes - 1));
+        const int note = int(pitch);
+        const double position = (pitch - note) * stepsPerSemitone;
+        const int step = int(position);
+        const double t = position - step;
+        const double ratio = stepRatio[step] + t * (stepRatio[step + 1] - stepRatio[step]);
+        return noteIncrement[note] * ratio;
+    }
+
+private:
+    static int clampNote(int note)
+    {
+        return note < 0 ? 0 : (note >= numNotes ? numNotes - 1 : note);
+    }
+
+    double sampleRate = 0.0;
+    double noteFrequency[numNotes];
+    double noteIncrement[numNotes];
+    double stepRatio[stepsPerSemitone + 1];
+};
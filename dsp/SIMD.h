@@ -0,0 +1,65 @@
+#pragma once
+
+/*
+  Helpers for choosing between SIMD code paths at runtime.
+
+  On x86-64 every CPU has SSE2, so that is the baseline. Functions marked
+  with DSP_TARGET_AVX2 are compiled for AVX2 and FMA, even if the rest of
+  the program isn't, and must only be called when cpuHasAVX2() says so.
+  A function marked DSP_INLINE that gets called from a DSP_TARGET_AVX2
+  function is inlined into it and also compiled for AVX2. This makes it
+  possible to write a loop once in plain C++ and have the compiler
+  vectorize it for both instruction sets.
+
+  On ARM, NEON is always available and there is nothing to choose.
+ */
+
+#if defined(__x86_64__) || defined(_M_X64)
+  #define DSP_X86 1
+  #include <immintrin.h>
+  #if defined(_MSC_VER) && !defined(__clang__)
+    #include <intrin.h>
+    #define DSP_TARGET_AVX2
+    #define DSP_INLINE __forceinline
+  #else
+    #define DSP_TARGET_AVX2 __attribute__((target("avx2,fma")))
+    #define DSP_INLINE inline __attribute__((always_inline))
+  #endif
+#else
+  #if defined(__ARM_NEON)
+    #define DSP_NEON 1
+    #include <arm_neon.h>
+  #endif
+  #if defined(_MSC_VER) && !defined(__clang__)
+    #define DSP_INLINE __forceinline
+  #else
+    #define DSP_INLINE inline __attribute__((always_inline))
+  #endif
+#endif
+
+#ifdef DSP_X86
+
+inline bool cpuHasAVX2()
+{
+    #if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuid(info, 1);
+    const bool hasFMA = (info[2] & (1 << 12)) != 0;
+    const bool hasOSXSAVE = (info[2] & (1 << 27)) != 0;
+    const bool hasAVX = (info[2] & (1 << 28)) != 0;
+    if (!hasFMA || !hasOSXSAVE || !hasAVX || (_xgetbv(0) & 6) != 6) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+    #else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    #endif
+}
+
+#endif  // DSP_X86
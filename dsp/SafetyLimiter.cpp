@@ -0,0 +1,152 @@
+#include "SafetyLimiter.h"
+#include "SIMD.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+constexpr int32_t ONE_BITS = 0x3F800000;  // 1.0f
+constexpr int32_t TWO_BITS = 0x40000000;  // 2.0f
+constexpr int32_t INF_BITS = 0x7F800000;
+
+inline int32_t magnitudeBits(float x)
+{
+    int32_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    return bits & 0x7FFFFFFF;
+}
+
+int32_t peakBitsScalar(const float* buffer, int sampleCount, int start, int32_t peak)
+{
+    for (int i = start; i < sampleCount; ++i) {
+        peak = std::max(peak, magnitudeBits(buffer[i]));
+    }
+    return peak;
+}
+
+/*
+  The SIMD versions keep a running max in every lane and combine the lanes
+  at the end. The leftover samples are done by the scalar loop.
+ */
+
+#ifdef DSP_X86
+
+int32_t peakBitsSSE2(const float* buffer, int sampleCount)
+{
+    const __m128i mask = _mm_set1_epi32(0x7FFFFFFF);
+    __m128i peak = _mm_setzero_si128();
+
+    int i = 0;
+    for (; i + 4 <= sampleCount; i += 4) {
+        __m128i x = _mm_and_si128(_mm_castps_si128(_mm_loadu_ps(buffer + i)), mask);
+
+        // SSE2 has no 32-bit integer max, so select with a compare.
+        __m128i greater = _mm_cmpgt_epi32(x, peak);
+        peak = _mm_or_si128(_mm_and_si128(greater, x), _mm_andnot_si128(greater, peak));
+    }
+
+    int32_t lanes[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), peak);
+    int32_t result = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+    return peakBitsScalar(buffer, sampleCount, i, result);
+}
+
+DSP_TARGET_AVX2 int32_t peakBitsAVX2(const float* buffer, int sampleCount)
+{
+    const __m256i mask = _mm256_set1_epi32(0x7FFFFFFF);
+    __m256i peak = _mm256_setzero_si256();
+
+    int i = 0;
+    for (; i + 8 <= sampleCount; i += 8) {
+        __m256i x = _mm256_and_si256(_mm256_castps_si256(_mm256_loadu_ps(buffer + i)), mask);
+        peak = _mm256_max_epi32(peak, x);
+    }
+
+    __m128i half = _mm_max_epi32(_mm256_castsi256_si128(peak), _mm256_extracti128_si256(peak, 1));
+    int32_t lanes[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), half);
+    int32_t result = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+    return peakBitsScalar(buffer, sampleCount, i, result);
+}
+
+const bool useAVX2 = cpuHasAVX2();
+
+#endif  // DSP_X86
+
+#ifdef DSP_NEON
+
+int32_t peakBitsNEON(const float* buffer, int sampleCount)
+{
+    const int32x4_t mask = vdupq_n_s32(0x7FFFFFFF);
+    int32x4_t peak = vdupq_n_s32(0);
+
+    int i = 0;
+    for (; i + 4 <= sampleCount; i += 4) {
+        int32x4_t x = vandq_s32(vreinterpretq_s32_f32(vld1q_f32(buffer + i)), mask);
+        peak = vmaxq_s32(peak, x);
+    }
+
+    int32_t lanes[4];
+    vst1q_s32(lanes, peak);
+    int32_t result = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+    return peakBitsScalar(buffer, sampleCount, i, result);
+}
+
+#endif  // DSP_NEON
+
+/*
+  Returns the bits of the largest absolute sample value in the buffer.
+ */
+int32_t peakBits(const float* buffer, int sampleCount)
+{
+    #if defined(DSP_X86)
+    if (useAVX2) {
+        return peakBitsAVX2(buffer, sampleCount);
+    }
+    return peakBitsSSE2(buffer, sampleCount);
+    #elif defined(DSP_NEON)
+    return peakBitsNEON(buffer, sampleCount);
+    #else
+    return peakBitsScalar(buffer, sampleCount, 0, 0);
+    #endif
+}
+
+/*
+  Only needed when something is already wrong, so this doesn't have to be
+  fast. The compiler usually vectorizes it anyway.
+ */
+void clamp(float* buffer, int sampleCount)
+{
+    for (int i = 0; i < sampleCount; ++i) {
+        buffer[i] = std::min(std::max(buffer[i], -1.0f), 1.0f);
+    }
+}
+
+}  // namespace
+
+LimiterResult protectYourEars(float* buffer, int sampleCount)
+{
+    if (buffer == nullptr || sampleCount <= 0) {
+        return LimiterResult::ok;
+    }
+
+    const int32_t peak = peakBits(buffer, sampleCount);
+    if (peak <= ONE_BITS) {
+        return LimiterResult::ok;
+    }
+    if (peak <= TWO_BITS) {
+        clamp(buffer, sampleCount);
+        return LimiterResult::clamped;
+    }
+
+    std::memset(buffer, 0, sampleCount * sizeof(float));
+    if (peak > INF_BITS) {
+        return LimiterResult::nan;
+    } else if (peak == INF_BITS) {
+        return LimiterResult::inf;
+    } else {
+        return LimiterResult::outOfRange;
+    }
+}
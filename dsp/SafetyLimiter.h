@@ -0,0 +1,29 @@
+#pragma once
+
+/*
+  A last line of defense against blowing up your speakers (and your ears)
+  while experimenting with synthesis code.
+
+  The buffer is first scanned for the largest absolute sample value. Only if
+  that is out of range does a second pass go over the buffer: samples that
+  are slightly too loud get clamped to [-1, 1], but if the buffer contains
+  nan or inf, or samples louder than 2.0 (screaming feedback), the whole
+  buffer is silenced.
+
+  The scan looks at the bits of the float with the sign bit cleared. For any
+  finite number a larger magnitude is also a larger integer, and inf and nan
+  come after all finite numbers. That turns the check into a single integer
+  max over the buffer without any branches, which vectorizes nicely. Since
+  a buffer is almost always fine, the cost is usually just this one pass.
+ */
+
+enum class LimiterResult
+{
+    ok,          // nothing was changed
+    clamped,     // samples between 1 and 2 were clamped
+    outOfRange,  // silenced because of samples louder than 2
+    inf,         // silenced because of inf
+    nan,         // silenced because of nan
+};
+
+LimiterResult protectYourEars(float* buffer, int sampleCount);
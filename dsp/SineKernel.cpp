@@ -0,0 +1,245 @@
+#include "SineKernel.h"
+#include "MathConstants.h"
+#include "SIMD.h"
+
+#include <cmath>
+
+namespace {
+
+// Minimax coefficients for sin(2 pi x) = x (C1 + C3 x^2 + ... + C9 x^8) on
+// the interval x = [-0.25, 0.25]. The maximum error of the polynomial itself
+// is 3.3e-9; the rest of the error comes from rounding to float.
+constexpr float C1 =   6.2831851601e+00f;
+constexpr float C3 = -4.1341655024e+01f;
+constexpr float C5 =  8.1601003576e+01f;
+constexpr float C7 = -7.6549770070e+01f;
+constexpr float C9 =  3.9536607710e+01f;
+
+// The kernels work on the phase measured in cycles rather than radians.
+// `start` is the phase of the first sample and `step` the increment.
+typedef void (*SineKernelFn)(float* output, int sampleCount, double start, double step);
+
+inline double fraction(double x)
+{
+    return x - std::floor(x);
+}
+
+/*
+  Computes sin(2 pi x) for x in [0, 1).
+
+  Since sin(2 pi x) = -sin(2 pi (x - 0.5)) and the sine is symmetric around
+  a quarter cycle, the polynomial only needs to cover the first quarter of
+  the cycle. The SIMD versions below do exactly the same steps.
+ */
+inline float sineCycle(float x)
+{
+    float z = x - 0.5f;
+    float a = std::fabs(z);
+    float f = std::fmin(a, 0.5f - a);
+    float f2 = f * f;
+    float p = (((C9 * f2 + C7) * f2 + C5) * f2 + C3) * f2 + C1;
+    p *= f;
+    return (z < 0.0f) ? p : -p;
+}
+
+void sineScalar(float* output, int sampleCount, double start, double step)
+{
+    for (int i = 0; i < sampleCount; ++i) {
+        output[i] = sineCycle(float(fraction(start + double(i) * step)));
+    }
+}
+
+/*
+  The SIMD kernels compute the phase of the first sample of every group in
+  double precision, so that rounding errors don't build up over the block.
+  The other lanes add a small offset to that in float.
+ */
+
+#ifdef DSP_X86
+
+inline __m128 sineCycleSSE2(__m128 x)
+{
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+
+    __m128 z = _mm_sub_ps(x, half);
+    __m128 a = _mm_andnot_ps(signMask, z);
+    __m128 f = _mm_min_ps(a, _mm_sub_ps(half, a));
+    __m128 f2 = _mm_mul_ps(f, f);
+
+    __m128 p = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(C9), f2), _mm_set1_ps(C7));
+    p = _mm_add_ps(_mm_mul_ps(p, f2), _mm_set1_ps(C5));
+    p = _mm_add_ps(_mm_mul_ps(p, f2), _mm_set1_ps(C3));
+    p = _mm_add_ps(_mm_mul_ps(p, f2), _mm_set1_ps(C1));
+    p = _mm_mul_ps(p, f);
+
+    // Negate the lanes where z is not negative.
+    return _mm_xor_ps(p, _mm_andnot_ps(z, signMask));
+}
+
+void sineSSE2(float* output, int sampleCount, double start, double step)
+{
+    const __m128 offsets = _mm_setr_ps(0.0f,
+                                       float(fraction(step)),
+                                       float(fraction(2.0 * step)),
+                                       float(fraction(3.0 * step)));
+    int i = 0;
+    for (; i + 4 <= sampleCount; i += 4) {
+        __m128 x = _mm_add_ps(_mm_set1_ps(float(fraction(start + double(i) * step))), offsets);
+
+        // x is never negative, so truncating is the same as rounding down.
+        x = _mm_sub_ps(x, _mm_cvtepi32_ps(_mm_cvttps_epi32(x)));
+
+        _mm_storeu_ps(output + i, sineCycleSSE2(x));
+    }
+    sineScalar(output + i, sampleCount - i, start + double(i) * step, step);
+}
+
+DSP_TARGET_AVX2 inline __m256 sineCycleAVX2(__m256 x)
+{
+    const __m256 signMask = _mm256_set1_ps(-0.0f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+
+    __m256 z = _mm256_sub_ps(x, half);
+    __m256 a = _mm256_andnot_ps(signMask, z);
+    __m256 f = _mm256_min_ps(a, _mm256_sub_ps(half, a));
+    __m256 f2 = _mm256_mul_ps(f, f);
+
+    __m256 p = _mm256_fmadd_ps(_mm256_set1_ps(C9), f2, _mm256_set1_ps(C7));
+    p = _mm256_fmadd_ps(p, f2, _mm256_set1_ps(C5));
+    p = _mm256_fmadd_ps(p, f2, _mm256_set1_ps(C3));
+    p = _mm256_fmadd_ps(p, f2, _mm256_set1_ps(C1));
+    p = _mm256_mul_ps(p, f);
+
+    return _mm256_xor_ps(p, _mm256_andnot_ps(z, signMask));
+}
+
+DSP_TARGET_AVX2 void sineAVX2(float* output, int sampleCount, double start, double step)
+{
+    const __m256 offsets = _mm256_setr_ps(0.0f,
+                                          float(fraction(step)),
+                                          float(fraction(2.0 * step)),
+                                          float(fraction(3.0 * step)),
+                                          float(fraction(4.0 * step)),
+                                          float(fraction(5.0 * step)),
+                                          float(fraction(6.0 * step)),
+                                          float(fraction(7.0 * step)));
+    int i = 0;
+    for (; i + 8 <= sampleCount; i += 8) {
+        __m256 x = _mm256_add_ps(_mm256_set1_ps(float(fraction(start + double(i) * step))), offsets);
+        x = _mm256_sub_ps(x, _mm256_floor_ps(x));
+        _mm256_storeu_ps(output + i, sineCycleAVX2(x));
+    }
+    sineScalar(output + i, sampleCount - i, start + double(i) * step, step);
+}
+
+#endif  // DSP_X86
+
+#ifdef DSP_NEON
+
+inline float32x4_t sineCycleNEON(float32x4_t x)
+{
+    const float32x4_t half = vdupq_n_f32(0.5f);
+
+    float32x4_t z = vsubq_f32(x, half);
+    float32x4_t a = vabsq_f32(z);
+    float32x4_t f = vminq_f32(a, vsubq_f32(half, a));
+    float32x4_t f2 = vmulq_f32(f, f);
+
+    float32x4_t p = vmlaq_f32(vdupq_n_f32(C7), vdupq_n_f32(C9), f2);
+    p = vmlaq_f32(vdupq_n_f32(C5), p, f2);
+    p = vmlaq_f32(vdupq_n_f32(C3), p, f2);
+    p = vmlaq_f32(vdupq_n_f32(C1), p, f2);
+    p = vmulq_f32(p, f);
+
+    uint32x4_t positive = vcgeq_f32(z, vdupq_n_f32(0.0f));
+    return vbslq_f32(positive, vnegq_f32(p), p);
+}
+
+void sineNEON(float* output, int sampleCount, double start, double step)
+{
+    const float offsetValues[4] = {
+        0.0f,
+        float(fraction(step)),
+        float(fraction(2.0 * step)),
+        float(fraction(3.0 * step)),
+    };
+    const float32x4_t offsets = vld1q_f32(offsetValues);
+
+    int i = 0;
+    for (; i + 4 <= sampleCount; i += 4) {
+        float32x4_t x = vaddq_f32(vdupq_n_f32(float(fraction(start + double(i) * step))), offsets);
+        x = vsubq_f32(x, vcvtq_f32_s32(vcvtq_s32_f32(x)));
+        vst1q_f32(output + i, sineCycleNEON(x));
+    }
+    sineScalar(output + i, sampleCount - i, start + double(i) * step, step);
+}
+
+#endif  // DSP_NEON
+
+struct SineKernel
+{
+    SineKernelFn function;
+    const char* name;
+};
+
+SineKernel selectSineKernel()
+{
+    #if defined(DSP_X86)
+    if (cpuHasAVX2()) {
+        return { sineAVX2, "avx2" };
+    }
+    return { sineSSE2, "sse2" };
+    #elif defined(DSP_NEON)
+    return { sineNEON, "neon" };
+    #else
+    return { sineScalar, "scalar" };
+    #endif
+}
+
+const SineKernel sineKernel = selectSineKernel();
+
+}  // namespace
+
+void renderSine(float* output, int sampleCount, double phase, double inc)
+{
+    sineKernel.function(output, sampleCount, phase * INV_TWO_PI, inc * INV_TWO_PI);
+}
+
+void renderSineQuadrature(float* output, int sampleCount, double phase, double inc)
+{
+    constexpr int lanes = 4;
+
+    // Lane k starts at phase + k*inc and advances by lanes*inc per step.
+    double c[lanes], s[lanes];
+    c[0] = std::cos(phase);
+    s[0] = std::sin(phase);
+
+    const double cosInc = std::cos(inc);
+    const double sinInc = std::sin(inc);
+    for (int k = 1; k < lanes; ++k) {
+        c[k] = c[k - 1] * cosInc - s[k - 1] * sinInc;
+        s[k] = s[k - 1] * cosInc + c[k - 1] * sinInc;
+    }
+
+    const double cosStep = std::cos(lanes * inc);
+    const double sinStep = std::sin(lanes * inc);
+
+    int i = 0;
+    for (; i + lanes <= sampleCount; i += lanes) {
+        for (int k = 0; k < lanes; ++k) {
+            output[i + k] = float(s[k]);
+            double cosNext = c[k] * cosStep - s[k] * sinStep;
+            s[k] = s[k] * cosStep + c[k] * sinStep;
+            c[k] = cosNext;
+        }
+    }
+    for (int k = 0; i < sampleCount; ++i, ++k) {
+        output[i] = float(s[k]);
+    }
+}
+
+const char* sineKernelName()
+{
+    return sineKernel.name;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+/*
+  Vectorized sine oscillator.
+
+  renderSine() fills the buffer with `sin(phase + i * inc)` for every sample
+  index `i`. Instead of calling std::sin, it evaluates a 9th-order polynomial
+  on 4 or 8 samples at once. Which instruction set to use (AVX2, SSE2, NEON,
+  or plain C++ as a fallback) is decided once when the program starts.
+
+  The maximum absolute error compared to std::sin is less than 1e-6, or
+  about -120 dB. The polynomial itself is much more accurate than that; the
+  error mostly comes from storing the phase in a 32-bit float.
+
+  Both `phase` and `inc` are in radians. The increment must not be negative.
+  The phase does not need to be wrapped into [0, 2pi) but doing so keeps the
+  result accurate.
+ */
+void renderSine(float* output, int sampleCount, double phase, double inc);
+
+/*
+  Recursive quadrature oscillator.
+
+  This computes the next sample by rotating the (cos, sin) vector of the
+  previous sample by `inc` radians, which needs only a few multiplies and
+  adds per sample and no polynomial. It uses four interleaved rotations so
+  that the loop can be vectorized. The rotations are done in double
+  precision and start over from the exact phase on every call, so the
+  amplitude does not drift.
+
+  This is only a win for fixed-frequency notes rendered in reasonably large
+  blocks, since each call needs a few std::sin and std::cos calls to set
+  things up.
+ */
+void renderSineQuadrature(float* output, int sampleCount, double phase, double inc);
+
+/*
+  Returns the name of the kernel that renderSine() uses on this CPU.
+ */
+const char* sineKernelName();
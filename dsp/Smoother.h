@@ -0,0 +1,88 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+/*
+  Smooths out changes to a parameter so that they don't cause zipper noise.
+
+  When the parameter gets a new target value, the smoother moves towards it
+  in a straight line that takes `rampTime` seconds. The slope is computed
+  once, when the target changes, so a block only needs to know how long
+  the ramp still lasts. This splits the block into a ramp part and a part
+  where the value stays constant, and both are simple loops without any
+  branches that the compiler can vectorize.
+
+  Call setTarget() once per block from the audio thread with the latest
+  value of the parameter. Nothing in here allocates or locks.
+ */
+class Smoother
+{
+public:
+    void reset(double sampleRate, double rampTime, float initialValue)
+    {
+        rampLength = std::max(int(sampleRate * rampTime), 1);
+        current = initialValue;
+        target = initialValue;
+        step = 0.0f;
+        remaining = 0;
+    }
+
+    void setTarget(float newTarget)
+    {
+        if (newTarget != target) {
+            target = newTarget;
+            remaining = rampLength;
+            step = (target - current) / float(rampLength);
+        }
+    }
+
+    bool isSmoothing() const
+    {
+        return remaining > 0;
+    }
+
+    float getValue() const
+    {
+        return current;
+    }
+
+    /*
+      Writes the next `sampleCount` values into `output` and moves the
+      smoother ahead by that many samples.
+     */
+    void fill(float* output, int sampleCount)
+    {
+        const int rampCount = std::min(remaining, sampleCount);
+        for (int i = 0; i < rampCount; ++i) {
+            output[i] = current + float(i + 1) * step;
+        }
+        advance(rampCount);
+
+        std::fill(output + rampCount, output + sampleCount, current);
+    }
+
+    /*
+      Moves ahead by `sampleCount` samples without rendering anything.
+     */
+    void skip(int sampleCount)
+    {
+        advance(std::min(remaining, sampleCount));
+    }
+
+private:
+    void advance(int rampCount)
+    {
+        remaining -= rampCount;
+
+        // Land exactly on the target, so that rounding errors in the slope
+        // don't leave the value slightly off.
+        current = (remaining == 0) ? target : current + float(rampCount) * step;
+    }
+
+    float current = 0.0f;
+    float target = 0.0f;
+    float step = 0.0f;
+    int remaining = 0;
+    int rampLength = 1;
+};
@@ -0,0 +1,772 @@
+#include "Synth.h"
+#include "MathConstants.h"
+#include "Noise.h"
+#include "SineKernel.h"
+#include "Wavetable.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// How many notes can play at the same time.
+constexpr int MAX_VOICES = 64;
+
+bool isNoteMessage(uint8_t status)
+{
+    const uint8_t type = status & 0xF0;
+    return type == 0x80 || type == 0x90;
+}
+
+// Instant on and off, for when the envelope is not used.
+EnvelopeSettings noEnvelope()
+{
+    EnvelopeSettings settings;
+    settings.attack = 0.0;
+    settings.decay = 0.0;
+    settings.sustain = 1.0;
+    settings.release = 0.0;
+    return settings;
+}
+
+//==============================================================================
+// The oscillators. Each one renders a block for a single voice.
+//==============================================================================
+
+struct SineOscillator
+{
+    static void render(VoicePool& voices, int v, float* output, int sampleCount)
+    {
+        renderSine(output, sampleCount, voices.phase[v], voices.inc[v]);
+    }
+};
+
+// Notes play at a fixed pitch during each block, so instead of evaluating
+// the sine polynomial the oscillator can also rotate a (cos, sin) vector,
+// which is even cheaper for large blocks.
+struct QuadratureSineOscillator
+{
+    static void render(VoicePool& voices, int v, float* output, int sampleCount)
+    {
+        renderSineQuadrature(output, sampleCount, voices.phase[v], voices.inc[v]);
+    }
+};
+
+template<Waveform waveform>
+struct WavetableOscillator
+{
+    static void render(VoicePool& voices, int v, float* output, int sampleCount)
+    {
+        renderWavetable(output, sampleCount, voices.phase[v], voices.inc[v], waveform, Interpolation::cubic);
+    }
+};
+
+struct WhiteNoiseOscillator
+{
+    static void render(VoicePool& voices, int v, float* output, int sampleCount)
+    {
+        renderWhiteNoise(output, sampleCount, voices.noiseSeed[v]);
+    }
+};
+
+struct LFSRNoiseOscillator
+{
+    static void render(VoicePool& voices, int v, float* output, int sampleCount)
+    {
+        renderLFSRNoise(output, sampleCount, voices.lfsrSeed[v]);
+    }
+};
+
+struct FilteredNoiseOscillator
+{
+    static void render(VoicePool& voices, int v, float* output, int sampleCount)
+    {
+        voices.filteredNoise[v].render(output, sampleCount);
+    }
+};
+
+struct ExplosionOscillator
+{
+    static void render(VoicePool& voices, int v, float* output, int sampleCount)
+    {
+        voices.explosion[v].render(output, sampleCount);
+    }
+};
+
+}  // namespace
+
+//==============================================================================
+
+void Synth::prepare(double sampleRate_, int maxBlockSize, int numGroups_, int channelsPerGroup_)
+{
+    sampleRate = sampleRate_;
+    oversampling = 1;
+    renderRate = sampleRate;
+    numGroups = std::min(std::max(numGroups_, 1), int(maxGroups));
+    channelsPerGroup = std::min(std::max(channelsPerGroup_, 1), 2);
+    renderChannelsPerGroup = 1;
+    hasSettings = false;
+    oscillator = 0;
+    useEnvelope = true;
+    selectVoiceKernel();
+
+    voices.allocate(MAX_VOICES);
+    modMatrix.prepare(MAX_VOICES);
+    modBuffer.assign(MAX_VOICES, 0.0f);
+    modulating = false;
+    modulatesAmplitude = false;
+    pitchTable.prepare(sampleRate);
+    outputLevel.reset(sampleRate, 0.02, 1.0f);
+    oscBuffer.assign(std::max(maxBlockSize, 32), 0.0f);
+    envBuffer.assign(oscBuffer.size(), 0.0f);
+    gainBuffer.assign(oscBuffer.size(), 0.0f);
+    busBuffer.assign(maxChannels * oscBuffer.size(), 0.0f);
+
+    oversamplers.resize(maxChannels);
+    for (auto& oversampler : oversamplers) {
+        oversampler.prepare(int(oscBuffer.size()));
+    }
+
+    // Build the wavetables now, so this doesn't happen on the audio thread.
+    Wavetables::shared();
+    reset();
+}
+
+void Synth::reset()
+{
+    voices.reset();
+    for (int channel = 0; channel < midiChannels; ++channel) {
+        channels[channel] = ChannelState();
+    }
+    changedChannels = 0;
+    controlPosition = 0;
+    for (auto& lfo : lfos) {
+        lfo.reset();
+    }
+    samplesUntilTick = 0;
+    for (auto& oversampler : oversamplers) {
+        oversampler.reset();
+    }
+}
+
+void Synth::setSettings(const SynthSettings& settings)
+{
+    oscillator = std::min(std::max(settings.oscillator, 0), 9);
+    const bool envelopeTurnedOff = useEnvelope && !settings.useEnvelope;
+    useEnvelope = settings.useEnvelope;
+    voiceStealing = settings.voiceStealing;
+
+    // A new bend range changes the pitch of every voice that is bent.
+    if (settings.pitchBendRange != pitchBendRange || settings.mpe != mpe
+            || settings.mpeBendRange != mpeBendRange) {
+        pitchBendRange = settings.pitchBendRange;
+        mpe = settings.mpe;
+        mpeBendRange = settings.mpeBendRange;
+        changedChannels = 0xFFFF;
+        controlPosition = 0;
+    }
+
+    // There are only decimators for 2x and 4x. Any other factor becomes the
+    // next lower one of 1, 2 or 4, and anything below 2 turns it off.
+    const int factor = settings.oversampling;
+    setOversampling(factor >= 4 ? 4 : (factor >= 2 ? 2 : 1));
+
+    // With a spread of zero every voice is in the center, so each group can
+    // be rendered in mono and copied to the right channel afterwards.
+    stereoSpread = settings.stereoSpread;
+    const int renderChannels = (channelsPerGroup == 2 && stereoSpread > 0.0f) ? 2 : 1;
+    if (renderChannels != renderChannelsPerGroup) {
+        // The oversamplers now belong to different channels, so their
+        // filter history no longer applies.
+        renderChannelsPerGroup = renderChannels;
+        for (auto& oversampler : oversamplers) {
+            oversampler.reset();
+        }
+    }
+
+    // Any change to the level becomes a ramp inside the smoother, which
+    // then gets rendered with the audio.
+    if (hasSettings) {
+        outputLevel.setTarget(settings.outputLevel);
+    } else {
+        outputLevel.reset(sampleRate, 0.02, settings.outputLevel);
+        hasSettings = true;
+    }
+
+    envelopeSettings = useEnvelope ? settings.envelope : noEnvelope();
+
+    // The kernels without an envelope don't move it ahead, so a voice in
+    // the middle of a stage would stay there forever. Instead, the stages
+    // finish right away: released voices stop and held voices jump to full
+    // level, the same as notes that start without an envelope.
+    if (envelopeTurnedOff) {
+        for (int v = 0; v < voices.numActive; ++v) {
+            if (voices.isHeld(v)) {
+                voices.envelope[v].noteOn(envelopeSettings, renderRate);
+            } else {
+                voices.envelope[v].reset();
+            }
+        }
+        voices.removeFinished();
+    }
+
+    // When the amplitude modulation starts, it ramps from no change at all.
+    modulationSettings = settings.modulation;
+    modMatrix.setRoutes(modulationSettings);
+    modulating = modMatrix.hasRoutes();
+    modulationSettings.tickLength = std::min(std::max(modulationSettings.tickLength, 8), 256);
+    const bool amplitudeRouted = modMatrix.isRouted(ModDestination::amplitude);
+    if (amplitudeRouted && !modulatesAmplitude) {
+        std::fill(voices.gain.begin(), voices.gain.end(), 1.0f);
+        std::fill(voices.gainStep.begin(), voices.gainStep.end(), 0.0f);
+    }
+    modulatesAmplitude = amplitudeRouted;
+
+    selectVoiceKernel();
+}
+
+template<typename Oscillator>
+Synth::VoiceKernel Synth::kernelFor(bool withEnvelope, int numChannels)
+{
+    static const VoiceKernel kernels[2][2] = {
+        { &Synth::renderVoices<Oscillator, false, 1>, &Synth::renderVoices<Oscillator, false, 2> },
+        { &Synth::renderVoices<Oscillator, true, 1>,  &Synth::renderVoices<Oscillator, true, 2> },
+    };
+    return kernels[withEnvelope ? 1 : 0][numChannels - 1];
+}
+
+void Synth::selectVoiceKernel()
+{
+    // In the same order as the oscillator choices in SynthSettings.
+    typedef VoiceKernel (*KernelSelector)(bool, int);
+    static const KernelSelector selectors[] = {
+        &kernelFor<SineOscillator>,
+        &kernelFor<WavetableOscillator<Waveform::sine>>,
+        &kernelFor<WavetableOscillator<Waveform::saw>>,
+        &kernelFor<WavetableOscillator<Waveform::square>>,
+        &kernelFor<WavetableOscillator<Waveform::triangle>>,
+        &kernelFor<WhiteNoiseOscillator>,
+        &kernelFor<LFSRNoiseOscillator>,
+        &kernelFor<FilteredNoiseOscillator>,
+        &kernelFor<ExplosionOscillator>,
+        &kernelFor<QuadratureSineOscillator>,
+    };
+    // The amplitude modulation is applied to the envelope, so it needs the
+    // kernels with an envelope, even if that's one that is always 1.
+    voiceKernel = selectors[oscillator](useEnvelope || modulatesAmplitude, renderChannelsPerGroup);
+}
+
+void Synth::setOversampling(int factor)
+{
+    if (factor == oversampling) {
+        return;
+    }
+
+    // Voices that are already playing keep their pitch. Envelope stages that
+    // are in progress finish at the old rate, the next stage uses the new one.
+    const double scale = double(oversampling) / double(factor);
+    for (int v = 0; v < voices.numActive; ++v) {
+        voices.inc[v] *= scale;
+        voices.noteInc[v] *= scale;
+    }
+
+    oversampling = factor;
+    renderRate = sampleRate * factor;
+    for (auto& oversampler : oversamplers) {
+        oversampler.reset();
+    }
+}
+
+void Synth::skip(int sampleCount)
+{
+    outputLevel.skip(sampleCount);
+
+    // Clearing the filters touches a whole block of history, so only do
+    // it once when the synth goes idle, not for every skipped block.
+    if (oversamplersUsed) {
+        for (auto& oversampler : oversamplers) {
+            oversampler.reset();
+        }
+        oversamplersUsed = false;
+    }
+}
+
+//==============================================================================
+
+void Synth::render(float* const* outputs, int sampleCount, const MidiEvent* events, int eventCount)
+{
+    // Render the samples up to each note, and handle all the events at the
+    // same position before rendering anything else. Events that are out of
+    // order are handled as soon as possible. Controller changes are applied
+    // at the next control tick, or together with the next note.
+    int bufferOffset = 0;
+    for (int i = 0; i < eventCount; ++i) {
+        const MidiEvent& event = events[i];
+        const int position = std::max(std::min(event.position, sampleCount), bufferOffset);
+
+        if (changedChannels != 0 && controlPosition <= position) {
+            renderUntil(outputs, bufferOffset, controlPosition);
+            applyControls();
+        }
+
+        if (isNoteMessage(event.data[0])) {
+            renderUntil(outputs, bufferOffset, position);
+            if (changedChannels != 0) {
+                applyControls();
+            }
+        } else if (changedChannels == 0) {
+            controlPosition = (position + controlInterval - 1) / controlInterval * controlInterval;
+        }
+
+        handleMIDI(event.data[0], event.data[1], event.data[2]);
+    }
+
+    if (changedChannels != 0 && controlPosition < sampleCount) {
+        renderUntil(outputs, bufferOffset, controlPosition);
+        applyControls();
+    }
+    renderUntil(outputs, bufferOffset, sampleCount);
+
+    // A change that is due after this block gets applied early in the next.
+    controlPosition = std::max(controlPosition - sampleCount, 0);
+
+    #ifdef ENABLE_INSTRUMENTATION
+    const auto limiterStart = Instrumentation::Clock::now();
+    #endif
+
+    limitOutput(outputs, sampleCount);
+
+    #ifdef ENABLE_INSTRUMENTATION
+    stats.limiterTime += Instrumentation::microsecondsSince(limiterStart);
+    #endif
+}
+
+void Synth::limitOutput(float* const* outputs, int sampleCount)
+{
+    // This runs once per block in release builds too, so it only does a
+    // single vectorized scan over each channel unless something is wrong.
+    // Without panning, the right channel of each group is a copy of the left
+    // one. That is filled in here, in one go, after the left was checked.
+    limiterResult = LimiterResult::ok;
+    for (int channel = 0; channel < numGroups * channelsPerGroup; ++channel) {
+        if (isDuplicateChannel(channel)) {
+            std::memcpy(outputs[channel], outputs[channel - 1], sampleCount * sizeof(float));
+        } else {
+            LimiterResult result = protectYourEars(outputs[channel], sampleCount);
+            limiterResult = std::max(limiterResult, result);
+        }
+    }
+}
+
+bool Synth::isDuplicateChannel(int channel) const
+{
+    return channelsPerGroup == 2 && renderChannelsPerGroup == 1 && (channel % 2) == 1;
+}
+
+void Synth::renderUntil(float* const* outputs, int& bufferOffset, int end)
+{
+    if (end > bufferOffset) {
+        processSamples(outputs, bufferOffset, end - bufferOffset);
+        bufferOffset = end;
+    }
+}
+
+/*
+  Gives the voices on the channels that changed their new pitch. This is
+  the only place where controllers touch the voices, so however many
+  messages came in since the last time, this loop runs once.
+ */
+void Synth::applyControls()
+{
+    for (int v = 0; v < voices.numActive; ++v) {
+        if (changedChannels & (1u << voices.channel[v])) {
+            voices.setPitch(v, noteIncrement(voices.note[v], voices.channel[v]));
+        }
+    }
+    changedChannels = 0;
+}
+
+void Synth::handleMIDI(uint8_t data0, uint8_t data1, uint8_t data2)
+{
+    const int channel = data0 & 0x0F;
+
+    switch (data0 & 0xF0) {
+        case 0x80:
+            noteOff(data1, channel);
+            break;
+
+        case 0x90: {
+            uint8_t note = data1;
+            uint8_t velo = data2;
+            if (velo > 0) {
+                noteOn(note, velo, channel);
+            } else {
+                noteOff(note, channel);
+            }
+            break;
+        }
+
+        case 0xB0:
+            controlChange(channel, data1, data2);
+            break;
+
+        case 0xD0:
+            channels[channel].pressure = float(data1) / 127.0f;
+            break;
+
+        case 0xE0: {
+            // 14 bits with the center at 8192. Full down is -1, full up is
+            // just short of 1.
+            const int value = (int(data2) << 7) | data1;
+            channels[channel].pitchBend = float(value - 8192) / 8192.0f;
+
+            // In MPE, the master channel bends all the notes.
+            changedChannels |= (mpe && channel == 0) ? 0xFFFFu : (1u << channel);
+            break;
+        }
+    }
+}
+
+void Synth::controlChange(int channel, int controller, int value)
+{
+    switch (controller) {
+        case 1:
+            channels[channel].modWheel = float(value) / 127.0f;
+            break;
+
+        case 64:
+            setSustain(channel, value >= 64);
+            break;
+
+        case 121:
+            resetControllers(channel);
+            break;
+
+        case 123: {
+            // All notes off. Notes held by the pedal stay on.
+            for (int v = voices.numActive - 1; v >= 0; --v) {
+                if (voices.channel[v] == channel && voices.isHeld(v)) {
+                    noteOff(voices.note[v], channel);
+                }
+            }
+            break;
+        }
+    }
+}
+
+void Synth::setSustain(int channel, bool down)
+{
+    const bool wasSustained = isSustained(channel);
+    channels[channel].sustain = down;
+    if (wasSustained && !isSustained(channel)) {
+        releaseSustainedNotes(channel);
+    }
+
+    // Lifting the pedal on the MPE master channel lets go of the notes on
+    // the member channels that don't have their own pedal down.
+    if (mpe && channel == 0 && !down) {
+        for (int member = 1; member < midiChannels; ++member) {
+            if (!channels[member].sustain) {
+                releaseSustainedNotes(member);
+            }
+        }
+    }
+}
+
+void Synth::releaseSustainedNotes(int channel)
+{
+    for (int v = voices.numActive - 1; v >= 0; --v) {
+        if (voices.channel[v] == channel && voices.sustained[v] && voices.isHeld(v)) {
+            voices.sustained[v] = 0;
+            noteOff(voices.note[v], channel);
+        }
+    }
+}
+
+void Synth::resetControllers(int channel)
+{
+    const bool sustain = channels[channel].sustain;
+    channels[channel] = ChannelState();
+    channels[channel].sustain = sustain;
+    setSustain(channel, false);
+    changedChannels |= (mpe && channel == 0) ? 0xFFFFu : (1u << channel);
+}
+
+bool Synth::isSustained(int channel) const
+{
+    return channels[channel].sustain || (mpe && channels[0].sustain);
+}
+
+double Synth::bendInSemitones(int channel) const
+{
+    if (mpe && channel != 0) {
+        return double(channels[channel].pitchBend) * mpeBendRange
+             + double(channels[0].pitchBend) * pitchBendRange;
+    }
+    return double(channels[channel].pitchBend) * pitchBendRange;
+}
+
+double Synth::noteIncrement(int note, int channel) const
+{
+    // The pitch table is for the normal sample rate. Dividing by a power of
+    // two gives the increment for the oversampled rate without any rounding.
+    const double bend = bendInSemitones(channel);
+    const double inc = (bend == 0.0) ? pitchTable.increment(note) : pitchTable.increment(note + bend);
+    return inc / double(oversampling);
+}
+
+void Synth::noteOn(int note, int velocity, int channel)
+{
+    int v = voices.voiceForNote(note, channel, voiceStealing);
+    voices.sustained[v] = 0;
+    voices.amplitude[v] = (velocity / 127.0) * 0.5;
+    voices.velocity[v] = float(velocity) / 127.0f;
+    voices.group[v] = mpe ? 0 : channel % numGroups;
+
+    // Spread the notes across the stereo field from low to high, using a
+    // constant-power pan law. A note in the center gets gain 1 on both sides.
+    const double position = std::min(std::max(double(note - 60) / 36.0, -1.0), 1.0);
+    const double angle = (stereoSpread * position + 1.0) * PI / 4.0;
+    voices.panLeft[v] = float(std::cos(angle) * SQRT2);
+    voices.panRight[v] = float(std::sin(angle) * SQRT2);
+    voices.envelope[v].noteOn(envelopeSettings, renderRate);
+
+    startSound(v, note);
+}
+
+void Synth::noteOff(int note, int channel)
+{
+    int v = voices.heldVoice(note, channel);
+    if (v >= 0 && isSustained(channel)) {
+        voices.sustained[v] = 1;  // released when the pedal comes up
+    } else if (v >= 0) {
+        voices.release(v);
+        voices.envelope[v].noteOff(envelopeSettings, renderRate);
+        voices.removeFinished();
+    }
+}
+
+//==============================================================================
+// The synthesis algorithm
+//==============================================================================
+
+void Synth::startSound(int v, int note)
+{
+    const double frequency = pitchTable.frequency(note);
+    voices.pitchRatio[v] = 1.0f;
+    voices.setPitch(v, noteIncrement(note, voices.channel[v]));
+    voices.gain[v] = 1.0f;
+    voices.gainStep[v] = 0.0f;
+
+    // The filtered noise uses the note's pitch as the cutoff, so it can be
+    // played from the keyboard. The explosion ignores the pitch.
+    voices.filteredNoise[v] = FilteredNoise(voices.nextSeed(v));
+    voices.filteredNoise[v].setCutoff(float(frequency), float(renderRate));
+    voices.explosion[v] = Explosion(voices.nextSeed(v));
+    voices.explosion[v].start(float(renderRate));
+}
+
+/*
+  Evaluates the modulation matrix for all the voices at once, for the end
+  of the next control tick. The pitch and the noise cutoff jump to their new
+  values right away, the amplitude ramps there over the whole tick.
+ */
+void Synth::updateModulation()
+{
+    const int tickLength = modulationSettings.tickLength;
+    const double tickSeconds = double(tickLength) / sampleRate;
+    float lfoValues[ModulationSettings::numLFOs];
+    for (int i = 0; i < ModulationSettings::numLFOs; ++i) {
+        lfoValues[i] = lfos[i].next(modulationSettings.lfo[i], tickSeconds);
+    }
+
+    const int voiceCount = voices.numActive;
+    if (voiceCount == 0) {
+        return;
+    }
+
+    float* lfo1 = modMatrix.source(ModSource::lfo1);
+    float* lfo2 = modMatrix.source(ModSource::lfo2);
+    float* modWheel = modMatrix.source(ModSource::modWheel);
+    float* pressure = modMatrix.source(ModSource::pressure);
+    float* velocity = modMatrix.source(ModSource::velocity);
+    for (int v = 0; v < voiceCount; ++v) {
+        // In MPE, the master channel's controllers apply to every note.
+        const ChannelState& state = channels[voices.channel[v]];
+        const ChannelState& master = mpe ? channels[0] : state;
+        lfo1[v] = lfoValues[0];
+        lfo2[v] = lfoValues[1];
+        modWheel[v] = std::max(state.modWheel, master.modWheel);
+        pressure[v] = std::max(state.pressure, master.pressure);
+        velocity[v] = voices.velocity[v];
+    }
+
+    modMatrix.evaluate(voiceCount);
+
+    if (modMatrix.isRouted(ModDestination::pitch)) {
+        const float* pitch = modMatrix.destination(ModDestination::pitch);
+        float* ratio = modBuffer.data();
+        for (int v = 0; v < voiceCount; ++v) {
+            ratio[v] = pitch[v] * (1.0f / 12.0f);
+        }
+        fastExp2(ratio, ratio, voiceCount);
+        for (int v = 0; v < voiceCount; ++v) {
+            voices.pitchRatio[v] = ratio[v];
+            voices.inc[v] = voices.noteInc[v] * ratio[v];
+        }
+    }
+
+    if (modulatesAmplitude) {
+        const float* amplitude = modMatrix.destination(ModDestination::amplitude);
+        const float rampLength = float(tickLength * oversampling);
+        for (int v = 0; v < voiceCount; ++v) {
+            const float target = std::max(1.0f + amplitude[v], 0.0f);
+            voices.gainStep[v] = (target - voices.gain[v]) / rampLength;
+        }
+    }
+
+    if (modMatrix.isRouted(ModDestination::cutoff) && oscillator == 7) {
+        const float* cutoff = modMatrix.destination(ModDestination::cutoff);
+        for (int v = 0; v < voiceCount; ++v) {
+            const float frequency = float(pitchTable.frequency(voices.note[v])) * fastExp2(cutoff[v]);
+            voices.filteredNoise[v].setCutoff(frequency, float(renderRate));
+        }
+    }
+}
+
+void Synth::processSamples(float* const* outputs, int offset, int sampleCount)
+{
+    #ifdef ENABLE_INSTRUMENTATION
+    const auto segmentStart = Instrumentation::Clock::now();
+    #endif
+
+    // Render channel c of group g goes to output channel g * channelsPerGroup + c.
+    const int numRenderChannels = numGroups * renderChannelsPerGroup;
+    int outputChannel[maxChannels];
+    for (int g = 0; g < numGroups; ++g) {
+        for (int c = 0; c < renderChannelsPerGroup; ++c) {
+            outputChannel[g * renderChannelsPerGroup + c] = g * channelsPerGroup + c;
+        }
+    }
+
+    // Work in chunks that fit into the oscillator buffer. With oversampling,
+    // the voices are rendered into the bus buffer at the higher rate and
+    // then filtered down into the outputs.
+    //
+    // With modulation, the chunks also stop at every control tick, where
+    // the modulation is worked out for the next tick.
+    const int chunkSize = int(oscBuffer.size()) / oversampling;
+    int chunkLength = 0;
+    for (int chunkOffset = 0; chunkOffset < sampleCount; chunkOffset += chunkLength) {
+        chunkLength = std::min(chunkSize, sampleCount - chunkOffset);
+        if (modulating) {
+            if (samplesUntilTick == 0) {
+                updateModulation();
+                samplesUntilTick = modulationSettings.tickLength;
+            }
+            chunkLength = std::min(chunkLength, samplesUntilTick);
+            samplesUntilTick -= chunkLength;
+        }
+
+        const int renderLength = chunkLength * oversampling;
+        const int position = offset + chunkOffset;
+
+        float* bus[maxChannels];
+        for (int r = 0; r < numRenderChannels; ++r) {
+            if (oversampling == 1) {
+                bus[r] = outputs[outputChannel[r]] + position;
+            } else {
+                bus[r] = busBuffer.data() + r * oscBuffer.size();
+            }
+            std::memset(bus[r], 0, renderLength * sizeof(float));
+        }
+
+        (this->*voiceKernel)(bus, renderLength);
+        voices.advance(renderLength, TWO_PI);
+
+        if (oversampling > 1) {
+            for (int r = 0; r < numRenderChannels; ++r) {
+                oversamplers[r].decimate(bus[r], outputs[outputChannel[r]] + position, chunkLength, oversampling);
+            }
+            oversamplersUsed = true;
+        }
+
+        // Every channel gets the same level, so the smoother's ramp is
+        // rendered once and then multiplied with each of them.
+        float* gain = gainBuffer.data();
+        outputLevel.fill(gain, chunkLength);
+        for (int r = 0; r < numRenderChannels; ++r) {
+            float* output = outputs[outputChannel[r]] + position;
+            for (int sample = 0; sample < chunkLength; ++sample) {
+                output[sample] *= gain[sample];
+            }
+        }
+    }
+    voices.removeFinished();
+
+    #ifdef ENABLE_INSTRUMENTATION
+    const double segmentTime = Instrumentation::microsecondsSince(segmentStart);
+    stats.segmentCount += 1;
+    stats.renderTime += segmentTime;
+    stats.maxSegmentTime = std::max(stats.maxSegmentTime, segmentTime);
+    #endif
+}
+
+template<typename Oscillator, bool withEnvelope, int numChannels>
+void Synth::renderVoices(float* const* bus, int sampleCount)
+{
+    float* osc = oscBuffer.data();
+    float* env = envBuffer.data();
+
+    // Each voice first renders its oscillator and its envelope into
+    // temporary buffers, then multiplies them and adds the result to the
+    // bus for its group. The envelope renders one segment at a time, so none
+    // of these loops needs to check per sample which stage the envelope is
+    // in. The left and right channels are separate arrays, so panning is
+    // two independent multiply-adds that both vectorize.
+    //
+    // The template arguments are constants, so the compiler removes the
+    // branches below and inlines the oscillator.
+    for (int v = 0; v < voices.numActive; ++v) {
+        Oscillator::render(voices, v, osc, sampleCount);
+        if (withEnvelope) {
+            voices.envelope[v].render(env, sampleCount);
+
+            // The amplitude modulation is a straight line between its
+            // values at the control ticks.
+            if (modulatesAmplitude) {
+                const float gain = voices.gain[v];
+                const float step = voices.gainStep[v];
+                for (int sample = 0; sample < sampleCount; ++sample) {
+                    env[sample] *= gain + float(sample + 1) * step;
+                }
+                voices.gain[v] = gain + float(sampleCount) * step;
+            }
+        }
+
+        const float amplitude = static_cast<float>(voices.amplitude[v]);
+        float* left = bus[voices.group[v] * numChannels];
+
+        if (numChannels == 1) {
+            if (withEnvelope) {
+                for (int sample = 0; sample < sampleCount; ++sample) {
+                    left[sample] += amplitude * env[sample] * osc[sample];
+                }
+            } else {
+                for (int sample = 0; sample < sampleCount; ++sample) {
+                    left[sample] += amplitude * osc[sample];
+                }
+            }
+        } else {
+            float* right = bus[voices.group[v] * numChannels + 1];
+            const float gainLeft = amplitude * voices.panLeft[v];
+            const float gainRight = amplitude * voices.panRight[v];
+            for (int sample = 0; sample < sampleCount; ++sample) {
+                const float x = withEnvelope ? env[sample] * osc[sample] : osc[sample];
+                left[sample] += gainLeft * x;
+                right[sample] += gainRight * x;
+            }
+        }
+    }
+}
@@ -0,0 +1,255 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Envelope.h"
+#include "Instrumentation.h"
+#include "Modulation.h"
+#include "Oversampler.h"
+#include "PitchTable.h"
+#include "SafetyLimiter.h"
+#include "Smoother.h"
+#include "VoicePool.h"
+
+/*
+  A MIDI message for Synth::render(). The position is the sample inside the
+  block where the message takes effect.
+ */
+struct MidiEvent
+{
+    int position;
+    uint8_t data[3];
+};
+
+/*
+  Everything about the sound that can change while the synth is playing.
+ */
+struct SynthSettings
+{
+    // 0 = sine, 1 = sine from the wavetable, 2 = saw, 3 = square,
+    // 4 = triangle, 5 = white noise, 6 = LFSR noise, 7 = filtered noise,
+    // 8 = explosion, 9 = sine from a rotating vector. These are the same
+    // as the choices in the plug-in.
+    int oscillator = 0;
+
+    // 1 (off), 2 or 4. Other values are rounded down to one of these.
+    int oversampling = 1;
+
+    // How far the notes are spread out across the stereo field, 0 to 1.
+    // A note is panned when it starts, so changes only affect new notes
+    // and don't need smoothing.
+    float stereoSpread = 0.0f;
+
+    // Linear gain for the output. Changes are smoothed over 20 ms.
+    float outputLevel = 1.0f;
+
+    // Which voice a new note takes when all of them are playing.
+    VoiceStealing voiceStealing = VoiceStealing::released;
+
+    // How many semitones the pitch bend wheel goes up or down.
+    float pitchBendRange = 2.0f;
+
+    // MPE, lower zone. Channel 1 is the master channel and channels 2 to 16
+    // each play a single note, so that every note can have its own pitch
+    // bend. Those bends use `mpeBendRange`, and the bend on the master
+    // channel is added to them. All MPE notes play in the first group.
+    bool mpe = false;
+    float mpeBendRange = 48.0f;
+
+    // New envelope settings are used by the next note on or note off.
+    // Without the envelope, notes start and stop instantly.
+    bool useEnvelope = true;
+    EnvelopeSettings envelope;
+
+    // LFOs and modulation routes. Without any routes, the modulation costs
+    // nothing at all.
+    ModulationSettings modulation;
+};
+
+/*
+  What the controllers on a MIDI channel are set to.
+ */
+struct ChannelState
+{
+    float pitchBend = 0.0f;   // -1 to 1
+    float modWheel = 0.0f;    // CC 1, 0 to 1
+    float pressure = 0.0f;    // channel aftertouch, 0 to 1
+    bool sustain = false;     // CC 64, the sustain pedal
+};
+
+/*
+  The complete synthesizer, without any dependencies on JUCE.
+
+  The plug-in is a thin layer around this class that turns the parameters
+  into SynthSettings and the host's MidiBuffer into MidiEvents. The command
+  line tool uses the exact same code to render offline, which is as fast as
+  the CPU allows rather than tied to the speed of an audio device.
+
+  There are up to `maxGroups` groups of voices. Notes on MIDI channel 1 play
+  in group 1, channel 2 in group 2, and so on. Each group has one or two
+  output channels, so the output channels are laid out as group 1 left,
+  group 1 right, group 2 left, etc.
+
+  Notes split the block: everything before a note on or note off is
+  rendered first, then the note starts or stops at exactly its sample.
+  Controller messages (pitch bend, CCs, aftertouch) work at control rate.
+  They change the ChannelState right away, but the voices pick up the new
+  values at the next multiple of `controlInterval` samples, or at the next
+  note if that comes first. A flood of controller messages from hardware
+  then costs at most one split per interval, no matter how many arrive.
+
+  All memory is allocated by prepare(). After that, render() never
+  allocates or locks, so it is safe to call from the audio thread.
+ */
+class Synth
+{
+public:
+    static constexpr int maxGroups = 4;
+    static constexpr int maxChannels = 2 * maxGroups;
+    static constexpr int midiChannels = 16;
+
+    // How often, in samples, controller changes are applied to the voices.
+    // 32 samples is 0.7 ms at 48 kHz.
+    static constexpr int controlInterval = 32;
+
+    /*
+      Allocates everything. `maxBlockSize` does not limit how many samples
+      can be rendered at once, but larger blocks are split up internally.
+     */
+    void prepare(double sampleRate, int maxBlockSize, int numGroups, int channelsPerGroup);
+
+    // Stops all voices and puts the controllers back in their resting
+    // positions.
+    void reset();
+
+    /*
+      Call this between blocks to change the sound. The first call after
+      prepare() sets the output level without smoothing.
+     */
+    void setSettings(const SynthSettings& settings);
+
+    /*
+      Renders `sampleCount` samples into the output channels (there must be
+      numGroups * channelsPerGroup of them), while handling the MIDI events
+      at their sample positions. The events must be sorted by position. An
+      event at position `sampleCount` is handled after rendering, so that
+      the next block starts with it.
+
+      The output is always checked by the safety limiter.
+     */
+    void render(float* const* outputs, int sampleCount, const MidiEvent* events, int eventCount);
+
+    /*
+      Moves time ahead without rendering. Only use this when the synth is
+      idle, as the voices do not move ahead. The oversampling filters still
+      hold the last few samples of the voices that just finished. Those
+      are dropped, so the next note doesn't start with them.
+     */
+    void skip(int sampleCount);
+
+    // True when no voices are playing, so the output would be silent.
+    bool isIdle() const { return voices.numActive == 0; }
+
+    int activeVoiceCount() const { return voices.numActive; }
+    int outputChannelCount() const { return numGroups * channelsPerGroup; }
+    double getSampleRate() const { return sampleRate; }
+
+    const ChannelState& channelState(int channel) const { return channels[channel & 0x0F]; }
+
+    // The worst thing the safety limiter found during the last render().
+    LimiterResult lastLimiterResult() const { return limiterResult; }
+
+    #ifdef ENABLE_INSTRUMENTATION
+    // Timings of the work done by render(). The caller resets this at the
+    // start of each block and fills in the rest.
+    BlockStats stats;
+    #endif
+
+private:
+    void handleMIDI(uint8_t data0, uint8_t data1, uint8_t data2);
+    void noteOn(int note, int velocity, int channel);
+    void noteOff(int note, int channel);
+    void controlChange(int channel, int controller, int value);
+    void setSustain(int channel, bool down);
+    void releaseSustainedNotes(int channel);
+    void resetControllers(int channel);
+
+    void renderUntil(float* const* outputs, int& bufferOffset, int end);
+    void applyControls();
+    void updateModulation();
+    bool isSustained(int channel) const;
+    double bendInSemitones(int channel) const;
+    double noteIncrement(int note, int channel) const;
+
+    void setOversampling(int factor);
+    void startSound(int v, int note);
+    void processSamples(float* const* outputs, int offset, int sampleCount);
+
+    /*
+      A voice kernel renders all the voices for one particular combination
+      of oscillator, envelope, and number of channels. These are templates,
+      so each combination is compiled into its own loop with nothing left
+      to decide per voice or per sample. The settings pick the kernel.
+     */
+    typedef void (Synth::*VoiceKernel)(float* const* bus, int sampleCount);
+
+    template<typename Oscillator, bool withEnvelope, int numChannels>
+    void renderVoices(float* const* bus, int sampleCount);
+
+    template<typename Oscillator>
+    static VoiceKernel kernelFor(bool withEnvelope, int numChannels);
+
+    void selectVoiceKernel();
+    void limitOutput(float* const* outputs, int sampleCount);
+    bool isDuplicateChannel(int channel) const;
+
+    double sampleRate = 48000.0;
+    double renderRate = 48000.0;   // sampleRate times the oversampling factor
+    int oversampling = 1;
+    int oscillator = 0;
+    bool useEnvelope = true;
+    VoiceStealing voiceStealing = VoiceStealing::released;
+    float pitchBendRange = 2.0f;
+    bool mpe = false;
+    float mpeBendRange = 48.0f;
+    VoiceKernel voiceKernel = nullptr;
+
+    // Without stereo spread the groups are rendered in mono, and the right
+    // channel is filled in afterwards with a single copy.
+    int numGroups = 1;
+    int channelsPerGroup = 1;
+    int renderChannelsPerGroup = 1;
+    float stereoSpread = 0.0f;
+
+    VoicePool voices;
+    PitchTable pitchTable;
+
+    // One bit for each MIDI channel whose controllers have changed since the
+    // voices were last updated, and where in the block that update happens.
+    ChannelState channels[midiChannels];
+    uint32_t changedChannels = 0;
+    int controlPosition = 0;
+
+    // The modulation runs on its own ticks of `tickLength` samples, which
+    // continue from one block into the next.
+    ModulationSettings modulationSettings;
+    ModMatrix modMatrix;
+    LFO lfos[ModulationSettings::numLFOs];
+    bool modulating = false;
+    bool modulatesAmplitude = false;
+    int samplesUntilTick = 0;
+    std::vector<float> modBuffer;
+
+    Smoother outputLevel;
+    EnvelopeSettings envelopeSettings;
+    LimiterResult limiterResult = LimiterResult::ok;
+    bool hasSettings = false;
+
+    std::vector<float> oscBuffer;
+    std::vector<float> envBuffer;
+    std::vector<float> gainBuffer;
+    std::vector<float> busBuffer;    // one oscBuffer-sized row per channel
+    std::vector<Oversampler> oversamplers;
+    bool oversamplersUsed = false;   // their filters may hold old samples
+};
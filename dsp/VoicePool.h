@@ -0,0 +1,381 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "Envelope.h"
+#include "Explosion.h"
+
+/*
+  How to choose the voice that gets taken away from another note when a new
+  note comes in and all the voices are in use. The first two are O(1),
+  because they just take the front of a list. Quietest is O(n): it compares
+  the envelope levels of all the active voices. The levels change on every
+  sample, so keeping the voices sorted by level would cost more during
+  rendering than this scan does. The scan only happens when the pool is
+  full and a note has to steal a voice, never while rendering.
+ */
+enum class VoiceStealing
+{
+    released,   // the voice that was released longest ago, else the oldest
+    oldest,     // the voice whose note started first
+    quietest,   // the voice with the lowest envelope level
+};
+
+/*
+  A doubly-linked list of voices. The links are stored in arrays indexed by
+  the voice number (an intrusive list), so adding a voice, removing it, and
+  finding the first one are all O(1) and never allocate memory.
+ */
+struct VoiceList
+{
+    void allocate(int capacity)
+    {
+        prev.assign(capacity, -1);
+        next.assign(capacity, -1);
+        linked.assign(capacity, 0);
+        head = -1;
+        tail = -1;
+    }
+
+    void clear()
+    {
+        std::fill(linked.begin(), linked.end(), 0);
+        head = -1;
+        tail = -1;
+    }
+
+    void pushBack(int v)
+    {
+        prev[v] = tail;
+        next[v] = -1;
+        if (tail >= 0) {
+            next[tail] = v;
+        } else {
+            head = v;
+        }
+        tail = v;
+        linked[v] = 1;
+    }
+
+    void remove(int v)
+    {
+        if (!linked[v]) {
+            return;
+        }
+        if (prev[v] >= 0) {
+            next[prev[v]] = next[v];
+        } else {
+            head = next[v];
+        }
+        if (next[v] >= 0) {
+            prev[next[v]] = prev[v];
+        } else {
+            tail = prev[v];
+        }
+        linked[v] = 0;
+    }
+
+    // The voice in slot `from` was moved to slot `to`, which is not in the
+    // list. The neighbours are pointed at the new slot.
+    void relocate(int from, int to)
+    {
+        linked[to] = linked[from];
+        if (!linked[from]) {
+            return;
+        }
+        linked[from] = 0;
+        prev[to] = prev[from];
+        next[to] = next[from];
+        if (prev[to] >= 0) {
+            next[prev[to]] = to;
+        } else {
+            head = to;
+        }
+        if (next[to] >= 0) {
+            prev[next[to]] = to;
+        } else {
+            tail = to;
+        }
+    }
+
+    int head = -1;
+    int tail = -1;
+    std::vector<int> prev;
+    std::vector<int> next;
+    std::vector<uint8_t> linked;
+};
+
+/*
+  Holds the state for all the voices of the synth.
+
+  Instead of an array of Voice objects, each property lives in its own array
+  (structure-of-arrays). The playing voices are always packed into the first
+  `numActive` slots, so a loop over `0 ..< numActive` touches only contiguous
+  memory and the compiler can process several voices per SIMD instruction.
+
+  The arrays are allocated once by `allocate()`, which must be called from
+  `Synth::prepare()`. Nothing in here allocates memory after that, so it is
+  safe to use on the audio thread.
+
+  None of the MIDI handling has to search through the voices. A table with
+  an entry for every note on every MIDI channel says which voice is holding
+  that note. All active voices are also kept in a list in the order they
+  were started, and the released ones in a second list in the order they
+  were released. The front of these lists is the oldest voice or the one
+  that has been fading out the longest.
+ */
+struct VoicePool
+{
+    void allocate(int maxVoices)
+    {
+        capacity = maxVoices;
+        note.assign(capacity, 0);
+        phase.assign(capacity, 0.0);
+        inc.assign(capacity, 0.0);
+        noteInc.assign(capacity, 0.0);
+        pitchRatio.assign(capacity, 1.0f);
+        amplitude.assign(capacity, 0.0);
+        velocity.assign(capacity, 0.0f);
+        gain.assign(capacity, 1.0f);
+        gainStep.assign(capacity, 0.0f);
+        channel.assign(capacity, 0);
+        sustained.assign(capacity, 0);
+        group.assign(capacity, 0);
+        panLeft.assign(capacity, 1.0f);
+        panRight.assign(capacity, 1.0f);
+        envelope.assign(capacity, Envelope());
+        filteredNoise.assign(capacity, FilteredNoise(0));
+        explosion.assign(capacity, Explosion(0));
+        numActive = 0;
+
+        voiceForKey.assign(numKeys, -1);
+        age.allocate(capacity);
+        released.allocate(capacity);
+
+        // Give every voice its own noise sequence.
+        noiseSeed.resize(capacity);
+        lfsrSeed.resize(capacity);
+        for (int v = 0; v < capacity; ++v) {
+            noiseSeed[v] = 22222u + uint32_t(v) * 2654435761u;
+            lfsrSeed[v] = (0x55555555u ^ (uint32_t(v) * 2654435761u)) | 1u;
+        }
+    }
+
+    void reset()
+    {
+        for (int v = 0; v < numActive; ++v) {
+            if (isHeld(v)) {
+                voiceForKey[keyFor(note[v], channel[v])] = -1;
+            }
+        }
+        numActive = 0;
+        age.clear();
+        released.clear();
+    }
+
+    /*
+      Returns the index of the voice that should play this note. If the note
+      is already being held on this MIDI channel, its voice is retriggered.
+      Otherwise a free voice is used, or one is stolen when all voices are in
+      use.
+     */
+    int voiceForNote(int noteNumber, int midiChannel, VoiceStealing stealing)
+    {
+        const int key = keyFor(noteNumber, midiChannel);
+        int v = voiceForKey[key];
+        if (v < 0) {
+            if (numActive < capacity) {
+                v = numActive++;
+            } else {
+                v = voiceToSteal(stealing);
+                if (isHeld(v)) {
+                    voiceForKey[keyFor(note[v], channel[v])] = -1;
+                }
+                released.remove(v);
+            }
+            note[v] = noteNumber;
+            channel[v] = midiChannel;
+            voiceForKey[key] = v;
+            phase[v] = 0.0;
+            envelope[v].reset();
+        }
+
+        // A retriggered note counts as a new one for stealing.
+        age.remove(v);
+        age.pushBack(v);
+        return v;
+    }
+
+    // The voice that is holding this note, or -1 if there is none.
+    int heldVoice(int noteNumber, int midiChannel) const
+    {
+        return voiceForKey[keyFor(noteNumber, midiChannel)];
+    }
+
+    /*
+      Marks the voice as released. It keeps playing until its envelope has
+      finished, but it no longer belongs to the note, so playing the note
+      again gets a new voice.
+     */
+    void release(int v)
+    {
+        voiceForKey[keyFor(note[v], channel[v])] = -1;
+        released.pushBack(v);
+    }
+
+    bool isHeld(int v) const
+    {
+        return !released.linked[v];
+    }
+
+    // Gives the voice a new pitch, keeping the pitch modulation.
+    void setPitch(int v, double increment)
+    {
+        noteInc[v] = increment;
+        inc[v] = increment * pitchRatio[v];
+    }
+
+    /*
+      Returns a new random seed for this voice, for the generators that are
+      restarted on every note. This steps the voice's white noise generator.
+     */
+    uint32_t nextSeed(int v)
+    {
+        noiseSeed[v] = noiseSeed[v] * 196314165u + 907633515u;
+        return noiseSeed[v];
+    }
+
+    /*
+      Moves the oscillator phases of all voices ahead by `sampleCount`
+      samples. Every voice is independent, so this is a single vectorizable
+      pass over the arrays. The envelopes move ahead as they are rendered.
+     */
+    void advance(int sampleCount, double phaseLimit)
+    {
+        const double n = double(sampleCount);
+        for (int v = 0; v < numActive; ++v) {
+            phase[v] = std::fmod(phase[v] + n * inc[v], phaseLimit);
+        }
+    }
+
+    /*
+      Removes the voices that were released and whose envelope has
+      finished. Only the released voices need to be looked at. The last
+      active voice is moved into the hole to keep the arrays packed.
+     */
+    void removeFinished()
+    {
+        int v = released.head;
+        while (v >= 0) {
+            int next = released.next[v];
+            if (envelope[v].isIdle()) {
+                const int last = numActive - 1;
+                remove(v);
+                if (next == last) {
+                    next = v;  // moved into the hole
+                }
+            }
+            v = next;
+        }
+    }
+
+    int capacity = 0;
+    int numActive = 0;
+
+    std::vector<int> note;            // MIDI note number
+    std::vector<int> channel;         // MIDI channel the note was played on
+    std::vector<uint8_t> sustained;   // note off came while the pedal was down
+    std::vector<double> phase;        // oscillator phase in radians
+    std::vector<double> inc;          // phase increment per sample
+    std::vector<double> noteInc;      // increment for the note and pitch bend
+    std::vector<float> pitchRatio;    // from the modulation, inc = noteInc * ratio
+    std::vector<double> amplitude;    // from the note velocity
+    std::vector<float> velocity;      // 0 to 1, for the modulation
+    std::vector<float> gain;          // amplitude modulation, ramps every tick
+    std::vector<float> gainStep;
+    std::vector<int> group;           // which output bus the voice plays on
+    std::vector<float> panLeft;       // stereo gains, both 1 in the center
+    std::vector<float> panRight;
+    std::vector<Envelope> envelope;   // ADSR state
+    std::vector<uint32_t> noiseSeed;  // state of the white noise generator
+    std::vector<uint32_t> lfsrSeed;   // state of the LFSR, never 0
+    std::vector<FilteredNoise> filteredNoise;
+    std::vector<Explosion> explosion;
+
+private:
+    static constexpr int numKeys = 16 * 128;
+
+    static int keyFor(int noteNumber, int midiChannel)
+    {
+        return (midiChannel & 0x0F) * 128 + (noteNumber & 0x7F);
+    }
+
+    int voiceToSteal(VoiceStealing stealing) const
+    {
+        switch (stealing) {
+            case VoiceStealing::released:
+                return (released.head >= 0) ? released.head : age.head;
+
+            case VoiceStealing::oldest:
+                return age.head;
+
+            case VoiceStealing::quietest:
+                break;
+        }
+
+        // A linear scan over the active voices, see VoiceStealing.
+        int v = 0;
+        for (int i = 1; i < numActive; ++i) {
+            if (envelope[i].getLevel() < envelope[v].getLevel()) {
+                v = i;
+            }
+        }
+        return v;
+    }
+
+    void remove(int v)
+    {
+        age.remove(v);
+        released.remove(v);
+
+        const int last = --numActive;
+        if (v == last) {
+            return;
+        }
+
+        note[v] = note[last];
+        channel[v] = channel[last];
+        sustained[v] = sustained[last];
+        phase[v] = phase[last];
+        inc[v] = inc[last];
+        noteInc[v] = noteInc[last];
+        pitchRatio[v] = pitchRatio[last];
+        amplitude[v] = amplitude[last];
+        velocity[v] = velocity[last];
+        gain[v] = gain[last];
+        gainStep[v] = gainStep[last];
+        group[v] = group[last];
+        panLeft[v] = panLeft[last];
+        panRight[v] = panRight[last];
+        envelope[v] = envelope[last];
+        filteredNoise[v] = filteredNoise[last];
+        explosion[v] = explosion[last];
+
+        // Swap rather than copy the seeds, so that no two voices end up
+        // with the same noise.
+        std::swap(noiseSeed[v], noiseSeed[last]);
+        std::swap(lfsrSeed[v], lfsrSeed[last]);
+
+        age.relocate(last, v);
+        released.relocate(last, v);
+        if (isHeld(v)) {
+            voiceForKey[keyFor(note[v], channel[v])] = v;
+        }
+    }
+
+    std::vector<int> voiceForKey;     // voice holding each note, or -1
+    VoiceList age;                    // all active voices, oldest first
+    VoiceList released;               // released voices, longest ago first
+};
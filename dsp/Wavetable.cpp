@@ -0,0 +1,156 @@
+#include "Wavetable.h"
+#include "MathConstants.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+inline float linear(const float* table, int index, float frac)
+{
+    float a = table[index];
+    float b = table[index + 1];
+    return a + frac * (b - a);
+}
+
+// 4-point, 3rd-order Hermite (Catmull-Rom) interpolation.
+inline float cubic(const float* table, int index, float frac)
+{
+    float xm1 = table[index - 1];
+    float x0  = table[index];
+    float x1  = table[index + 1];
+    float x2  = table[index + 2];
+    float c1 = 0.5f * (x1 - xm1);
+    float c2 = xm1 - 2.5f * x0 + 2.0f * x1 - 0.5f * x2;
+    float c3 = 0.5f * (x2 - xm1) + 1.5f * (x0 - x1);
+    return ((c3 * frac + c2) * frac + c1) * frac + x0;
+}
+
+template<Interpolation interpolation>
+void renderTable(float* output, int sampleCount, double position, double step, const float* table)
+{
+    // The read position is computed from the start of the block rather than
+    // accumulated, and since the table size is a power of two, wrapping
+    // around is just a bitmask on the integer part.
+    constexpr int mask = Wavetables::tableSize - 1;
+
+    for (int i = 0; i < sampleCount; ++i) {
+        double p = position + double(i) * step;
+        int whole = int(p);
+        float frac = float(p - double(whole));
+        int index = whole & mask;
+
+        if (interpolation == Interpolation::cubic) {
+            output[i] = cubic(table, index, frac);
+        } else {
+            output[i] = linear(table, index, frac);
+        }
+    }
+}
+
+}  // namespace
+
+const Wavetables& Wavetables::shared()
+{
+    // C++11 guarantees this is constructed only once, even when multiple
+    // threads call shared() at the same time.
+    static const Wavetables wavetables;
+    return wavetables;
+}
+
+Wavetables::Wavetables()
+{
+    storage.resize(stride * (1 + 3 * numLevels));
+
+    fill(&storage[1], Waveform::sine, 1);
+
+    const Waveform waveforms[] = { Waveform::saw, Waveform::square, Waveform::triangle };
+    for (Waveform waveform : waveforms) {
+        for (int level = 0; level < numLevels; ++level) {
+            fill(const_cast<float*>(table(waveform, level)), waveform, (tableSize / 2) >> level);
+        }
+    }
+}
+
+void Wavetables::fill(float* table, Waveform waveform, int harmonics)
+{
+    // Because the harmonics are whole multiples of the fundamental, all the
+    // sine values needed can be looked up from a single period.
+    std::vector<double> sine(tableSize);
+    for (int n = 0; n < tableSize; ++n) {
+        sine[n] = std::sin(TWO_PI * double(n) / double(tableSize));
+    }
+
+    std::vector<double> sum(tableSize, 0.0);
+    for (int h = 1; h <= harmonics; ++h) {
+        double gain = 0.0;
+        switch (waveform) {
+            case Waveform::sine:
+                gain = (h == 1) ? 1.0 : 0.0;
+                break;
+            case Waveform::saw:
+                gain = ((h & 1) ? 2.0 : -2.0) / (PI * h);
+                break;
+            case Waveform::square:
+                gain = (h & 1) ? 4.0 / (PI * h) : 0.0;
+                break;
+            case Waveform::triangle:
+                gain = (h & 1) ? (((h & 3) == 1) ? 8.0 : -8.0) / (PI * PI * h * h) : 0.0;
+                break;
+        }
+        if (gain == 0.0) {
+            continue;
+        }
+        for (int n = 0; n < tableSize; ++n) {
+            sum[n] += gain * sine[(h * n) & (tableSize - 1)];
+        }
+    }
+
+    for (int n = 0; n < tableSize; ++n) {
+        table[n] = float(sum[n]);
+    }
+
+    // Guard points so that the interpolation doesn't need to wrap around.
+    table[-1] = table[tableSize - 1];
+    table[tableSize] = table[0];
+    table[tableSize + 1] = table[1];
+    table[tableSize + 2] = table[2];
+}
+
+const float* Wavetables::table(Waveform waveform, int level) const
+{
+    if (waveform == Waveform::sine) {
+        return &storage[1];
+    }
+    int index = 1 + (int(waveform) - 1) * numLevels + level;
+    return &storage[index * stride + 1];
+}
+
+int Wavetables::levelForIncrement(double inc)
+{
+    // Level L has (tableSize/2) >> L harmonics. The highest harmonic must
+    // stay below Nyquist, i.e. harmonics * inc < pi.
+    double cycles = inc * INV_TWO_PI * double(tableSize);
+    if (cycles <= 1.0) {
+        return 0;
+    }
+    int level = int(std::ceil(std::log2(cycles)));
+    return std::min(level, numLevels - 1);
+}
+
+void renderWavetable(float* output, int sampleCount, double phase, double inc,
+                     Waveform waveform, Interpolation interpolation)
+{
+    const Wavetables& wavetables = Wavetables::shared();
+    const float* table = wavetables.table(waveform, Wavetables::levelForIncrement(inc));
+
+    const double scale = INV_TWO_PI * double(Wavetables::tableSize);
+    double position = (phase - TWO_PI * std::floor(phase * INV_TWO_PI)) * scale;
+    double step = inc * scale;
+
+    if (interpolation == Interpolation::cubic) {
+        renderTable<Interpolation::cubic>(output, sampleCount, position, step, table);
+    } else {
+        renderTable<Interpolation::linear>(output, sampleCount, position, step, table);
+    }
+}
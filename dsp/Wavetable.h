@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+
+enum class Waveform
+{
+    sine,
+    saw,
+    square,
+    triangle,
+};
+
+enum class Interpolation
+{
+    linear,
+    cubic,
+};
+
+/*
+  Band-limited wavetables for the basic waveforms.
+
+  Every waveform except the sine has one table per octave (a "mip level").
+  Level 0 contains 1024 harmonics, level 1 has 512, and so on, until level 10
+  which only has the fundamental. The oscillator picks the level with the
+  most harmonics that are all still below the Nyquist frequency, so no
+  aliasing happens. The sine only needs a single table.
+
+  The tables are built the first time shared() is called and are never
+  modified afterwards, so every voice in every plug-in instance in the same
+  process can read from them at the same time. Building takes a few
+  milliseconds; call shared() from prepareToPlay() so that this doesn't
+  happen on the audio thread.
+ */
+class Wavetables
+{
+public:
+    static constexpr int tableSize = 2048;
+    static constexpr int numLevels = 11;
+
+    static const Wavetables& shared();
+
+    /*
+      Returns the samples for the given waveform and mip level. It is safe to
+      read one element before and three elements past the end of the table,
+      which makes interpolation a lot simpler.
+     */
+    const float* table(Waveform waveform, int level) const;
+
+    /*
+      Returns the mip level to use for an oscillator with the given phase
+      increment in radians.
+     */
+    static int levelForIncrement(double inc);
+
+private:
+    Wavetables();
+
+    static constexpr int guardSize = 4;
+    static constexpr int stride = tableSize + guardSize;
+
+    void fill(float* table, Waveform waveform, int harmonics);
+
+    // The sine table followed by all mip levels for the other waveforms.
+    std::vector<float> storage;
+};
+
+/*
+  Renders the waveform at the given phase and increment, both in radians,
+  using the shared tables. The mip level is chosen from the increment.
+ */
+void renderWavetable(float* output, int sampleCount, double phase, double inc,
+                     Waveform waveform, Interpolation interpolation);
@@ -0,0 +1,70 @@
+#include "InstrumentationEditor.h"
+#include "PluginProcessor.h"
+
+#ifdef ENABLE_INSTRUMENTATION
+
+#include <algorithm>
+
+InstrumentationEditor::InstrumentationEditor(SynthAudioProcessor& processor)
+    : AudioProcessorEditor(processor), synth(processor), parameterEditor(processor)
+{
+    addAndMakeVisible(parameterEditor);
+    addAndMakeVisible(statsLabel);
+    statsLabel.setJustificationType(juce::Justification::topLeft);
+    statsLabel.setFont(juce::Font(juce::Font::getDefaultMonospacedFontName(), 13.0f, juce::Font::plain));
+
+    setSize(500, 600);
+    startTimerHz(4);
+}
+
+InstrumentationEditor::~InstrumentationEditor()
+{
+    stopTimer();
+}
+
+void InstrumentationEditor::resized()
+{
+    auto bounds = getLocalBounds();
+    statsLabel.setBounds(bounds.removeFromBottom(100).reduced(8));
+    parameterEditor.setBounds(bounds);
+}
+
+void InstrumentationEditor::timerCallback()
+{
+    int blocks = 0;
+    double totalTime = 0.0, renderTime = 0.0, limiterTime = 0.0;
+    double maxSegmentTime = 0.0, maxBudgetUsed = 0.0, sumBudgetUsed = 0.0;
+    long long segments = 0;
+    int voices = 0;
+
+    BlockStats stats;
+    while (synth.instrumentation.pop(stats)) {
+        blocks += 1;
+        totalTime += stats.totalTime;
+        renderTime += stats.renderTime;
+        limiterTime += stats.limiterTime;
+        segments += stats.segmentCount;
+        maxSegmentTime = std::max(maxSegmentTime, stats.maxSegmentTime);
+        sumBudgetUsed += stats.budgetUsed;
+        maxBudgetUsed = std::max(maxBudgetUsed, stats.budgetUsed);
+        voices = stats.voiceCount;
+    }
+
+    if (blocks == 0) {
+        return;  // nothing new, keep showing the last results
+    }
+
+    const double n = double(blocks);
+    juce::String text;
+    text << "blocks: " << blocks << "   voices: " << voices << "\n"
+         << "per block: " << juce::String(totalTime / n, 2) << " us total, "
+         << juce::String(renderTime / n, 2) << " us render, "
+         << juce::String(limiterTime / n, 2) << " us limiter\n"
+         << "segments per block: " << juce::String(double(segments) / n, 1)
+         << "   slowest segment: " << juce::String(maxSegmentTime, 2) << " us\n"
+         << "budget used: " << juce::String(sumBudgetUsed / n * 100.0, 1) << "% average, "
+         << juce::String(maxBudgetUsed * 100.0, 1) << "% peak";
+    statsLabel.setText(text, juce::dontSendNotification);
+}
+
+#endif  // ENABLE_INSTRUMENTATION
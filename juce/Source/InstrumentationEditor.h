@@ -0,0 +1,30 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "../../dsp/Instrumentation.h"
+
+#ifdef ENABLE_INSTRUMENTATION
+
+class SynthAudioProcessor;
+
+/*
+  The usual generic editor with the timings from the audio thread below it.
+  The timings are collected a few times per second and summarized.
+ */
+class InstrumentationEditor : public juce::AudioProcessorEditor, private juce::Timer
+{
+public:
+    explicit InstrumentationEditor(SynthAudioProcessor& processor);
+    ~InstrumentationEditor() override;
+
+    void resized() override;
+
+private:
+    void timerCallback() override;
+
+    SynthAudioProcessor& synth;
+    juce::GenericAudioProcessorEditor parameterEditor;
+    juce::Label statsLabel;
+};
+
+#endif  // ENABLE_INSTRUMENTATION
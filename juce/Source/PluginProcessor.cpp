@@ -1,18 +1,42 @@
 #include "PluginProcessor.h"
 
-// To avoid clicks and pops when playing notes, we apply a simple envelope that
-// fades the sound in and out. Comment out the define to turn off this envelope.
-#define ENABLE_ENVELOPE
+// How many MIDI events the timeline holds before it must be rendered.
+constexpr int MAX_EVENTS = 1024;
 
-constexpr double PI     = 3.14159265358979323846264338327950288;
-constexpr double TWO_PI = 6.28318530717958647692528676655900576;
-constexpr double SQRT2  = 1.41421356237309504880168872420969808;
+static float decibelsToGain(float decibels)
+{
+    return std::pow(10.0f, decibels / 20.0f);
+}
 
 //==============================================================================
 
 SynthAudioProcessor::SynthAudioProcessor()
-    : AudioProcessor(BusesProperties().withOutput("Output", juce::AudioChannelSet::stereo(), true))
-{
+    : AudioProcessor(BusesProperties()
+                     .withOutput("Output", juce::AudioChannelSet::stereo(), true)
+                     .withOutput("Group 2", juce::AudioChannelSet::stereo(), false)
+                     .withOutput("Group 3", juce::AudioChannelSet::stereo(), false)
+                     .withOutput("Group 4", juce::AudioChannelSet::stereo(), false))
+{
+    oscillatorParam = dynamic_cast<juce::AudioParameterChoice*>(apvts.getParameter("oscillator"));
+    timingParam = dynamic_cast<juce::AudioParameterChoice*>(apvts.getParameter("timing"));
+    levelParam = apvts.getRawParameterValue("level");
+    attackParam = apvts.getRawParameterValue("attack");
+    decayParam = apvts.getRawParameterValue("decay");
+    sustainParam = apvts.getRawParameterValue("sustain");
+    releaseParam = apvts.getRawParameterValue("release");
+    envelopeParam = dynamic_cast<juce::AudioParameterBool*>(apvts.getParameter("envelope"));
+    envShapeParam = dynamic_cast<juce::AudioParameterChoice*>(apvts.getParameter("envShape"));
+    oversamplingParam = dynamic_cast<juce::AudioParameterChoice*>(apvts.getParameter("oversampling"));
+    spreadParam = apvts.getRawParameterValue("spread");
+    stealingParam = dynamic_cast<juce::AudioParameterChoice*>(apvts.getParameter("stealing"));
+    bendRangeParam = apvts.getRawParameterValue("bendRange");
+    mpeParam = dynamic_cast<juce::AudioParameterBool*>(apvts.getParameter("mpe"));
+    lfoRateParam = apvts.getRawParameterValue("lfoRate");
+    lfoShapeParam = dynamic_cast<juce::AudioParameterChoice*>(apvts.getParameter("lfoShape"));
+    vibratoParam = apvts.getRawParameterValue("vibrato");
+    tremoloParam = apvts.getRawParameterValue("tremolo");
+    lfoCutoffParam = apvts.getRawParameterValue("lfoCutoff");
+    modRateParam = dynamic_cast<juce::AudioParameterChoice*>(apvts.getParameter("modRate"));
 }
 
 SynthAudioProcessor::~SynthAudioProcessor()
@@ -41,7 +65,9 @@ bool SynthAudioProcessor::isMidiEffect() const
 
 double SynthAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    // After the last note off, the sound keeps going until the release
+    // stage of the envelope is finished.
+    return envelopeParam->get() ? releaseParam->load() * 0.001 : 0.0;
 }
 
 int SynthAudioProcessor::getNumPrograms()
@@ -67,12 +93,22 @@ void SynthAudioProcessor::changeProgramName(int /*index*/, const juce::String& /
 {
 }
 
-void SynthAudioProcessor::prepareToPlay(double sampleRate_, int /*samplesPerBlock*/)
+void SynthAudioProcessor::prepareToPlay(double sampleRate_, int samplesPerBlock)
 {
     sampleRate = sampleRate_;
-    activeNote = 0;
-    env = 0.0;
-    reset();
+    events.clear();
+    events.reserve(MAX_EVENTS);
+
+    // Every enabled output bus has the same number of channels as the main
+    // bus, and each one plays one group of voices.
+    const int channelsPerGroup = std::clamp(getChannelCountOfBus(false, 0), 1, 2);
+    const int numGroups = std::clamp(getTotalNumOutputChannels() / channelsPerGroup, 1, Synth::maxGroups);
+    synth.prepare(sampleRate, samplesPerBlock, numGroups, channelsPerGroup);
+
+    mixBufferSize = std::max(samplesPerBlock, 32);
+    mixBuffer.assign(Synth::maxChannels * mixBufferSize, 0.0f);
+
+    updateParameters();
 }
 
 void SynthAudioProcessor::releaseResources()
@@ -81,164 +117,186 @@ void SynthAudioProcessor::releaseResources()
 
 bool SynthAudioProcessor::isBusesLayoutSupported(const BusesLayout& layouts) const
 {
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-    &&  layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo()) {
+    const auto mainOutput = layouts.getMainOutputChannelSet();
+    if (mainOutput != juce::AudioChannelSet::mono()
+    &&  mainOutput != juce::AudioChannelSet::stereo()) {
         return false;
     }
+
+    // The group outputs must look like the main output, and can only be
+    // turned on in order, so that group N is always on bus N.
+    bool previousEnabled = true;
+    for (int bus = 1; bus < int(layouts.outputBuses.size()); ++bus) {
+        const auto channelSet = layouts.getChannelSet(false, bus);
+        if (channelSet.isDisabled()) {
+            previousEnabled = false;
+        } else if (!previousEnabled || channelSet != mainOutput) {
+            return false;
+        }
+    }
     return true;
 }
 
+static void checkOutput(LimiterResult result)
+{
+    switch (result) {
+        case LimiterResult::ok:
+            break;
+        case LimiterResult::clamped:
+            DBG("!!! WARNING: sample out of range, clamping !!!");
+            break;
+        case LimiterResult::outOfRange:
+            DBG("!!! WARNING: sample out of range, silencing !!!");
+            break;
+        case LimiterResult::inf:
+            DBG("!!! WARNING: inf detected in audio buffer, silencing !!!");
+            break;
+        case LimiterResult::nan:
+            DBG("!!! WARNING: nan detected in audio buffer, silencing !!!");
+            break;
+    }
+}
+
 void SynthAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+{
+    processBuffer(buffer, midiMessages);
+}
+
+void SynthAudioProcessor::processBlock(juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages)
+{
+    processBuffer(buffer, midiMessages);
+}
+
+bool SynthAudioProcessor::supportsDoublePrecisionProcessing() const
+{
+    return true;
+}
+
+template<typename SampleType>
+void SynthAudioProcessor::processBuffer(juce::AudioBuffer<SampleType>& buffer, juce::MidiBuffer& midiMessages)
 {
     juce::ScopedNoDenormals noDenormals;
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
+    const int sampleCount = buffer.getNumSamples();
 
     // Clear any output channels that don't contain input data.
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i) {
-        buffer.clear(i, 0, buffer.getNumSamples());
+        buffer.clear(i, 0, sampleCount);
     }
 
-    updateParameters();
-    splitBufferByEvents(buffer, midiMessages);
-}
-
-void SynthAudioProcessor::splitBufferByEvents(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
-{
-    int bufferOffset = 0;
-
-    for (const auto metadata : midiMessages) {
-        int samplesThisSegment = metadata.samplePosition - bufferOffset;
-        if (samplesThisSegment > 0) {
-            render(buffer, samplesThisSegment, bufferOffset);
-            bufferOffset += samplesThisSegment;
-        }
-        if (metadata.numBytes <= 3) {
-            uint8_t data1 = (metadata.numBytes >= 2) ? metadata.data[1] : 0;
-            uint8_t data2 = (metadata.numBytes == 3) ? metadata.data[2] : 0;
-            handleMIDI(metadata.data[0], data1, data2);
-        }
-    }
+    #ifdef ENABLE_INSTRUMENTATION
+    const auto blockStart = Instrumentation::Clock::now();
+    synth.stats = BlockStats();
+    synth.stats.sampleCount = sampleCount;
+    #endif
 
-    int samplesLastSegment = buffer.getNumSamples() - bufferOffset;
-    if (samplesLastSegment > 0) {
-        render(buffer, samplesLastSegment, bufferOffset);
-    }
+    updateParameters();
 
-    midiMessages.clear();
-}
+    // Most of the time a synth isn't playing anything. Without any voices
+    // or new notes the output is silence, so there is no need to render it
+    // or check it. AudioBuffer::clear() also marks the buffer as silent, so
+    // the host can skip it too.
+    if (synth.isIdle() && midiMessages.isEmpty()) {
+        synth.skip(sampleCount);
+        buffer.clear();
+    } else {
+        // The synth always renders in float. In a float buffer it renders
+        // straight into the output channels. For a double buffer it renders
+        // into the mix buffer first, one piece at a time, which then gets
+        // converted.
+        constexpr bool isFloat = std::is_same_v<SampleType, float>;
+        const int numChannels = synth.outputChannelCount();
+        jassert(numChannels <= buffer.getNumChannels());
+        const int sliceSize = isFloat ? sampleCount : mixBufferSize;
+
+        for (int offset = 0; offset < sampleCount; offset += sliceSize) {
+            const int sliceLength = std::min(sliceSize, sampleCount - offset);
+
+            float* mix[Synth::maxChannels];
+            for (int channel = 0; channel < numChannels; ++channel) {
+                if constexpr (isFloat) {
+                    mix[channel] = buffer.getWritePointer(channel) + offset;
+                } else {
+                    mix[channel] = mixBuffer.data() + channel * mixBufferSize;
+                }
+            }
 
-void SynthAudioProcessor::handleMIDI(uint8_t data0, uint8_t data1, uint8_t data2)
-{
-    switch (data0 & 0xF0) {
-        case 0x80:
-            noteOff(data1);
-            break;
+            renderSlice(midiMessages, sampleCount, offset, mix, sliceLength);
 
-        case 0x90: {
-            uint8_t note = data1;
-            uint8_t velo = data2;
-            if (velo > 0) {
-                noteOn(note, velo);
-            } else {
-                noteOff(note);
+            if constexpr (!isFloat) {
+                for (int channel = 0; channel < numChannels; ++channel) {
+                    std::copy(mix[channel], mix[channel] + sliceLength, buffer.getWritePointer(channel) + offset);
+                }
             }
-            break;
         }
+        midiMessages.clear();
     }
-}
 
-static void protectYourEars(float* buffer, int sampleCount)
-{
-    if (buffer == nullptr) { return; }
-    bool firstWarning = true;
-    for (int i = 0; i < sampleCount; ++i) {
-        float x = buffer[i];
-        bool silence = false;
-        if (std::isnan(x)) {
-            DBG("!!! WARNING: nan detected in audio buffer, silencing !!!");
-            silence = true;
-        } else if (std::isinf(x)) {
-            DBG("!!! WARNING: inf detected in audio buffer, silencing !!!");
-            silence = true;
-        } else if (x < -2.0f || x > 2.0f) {  // screaming feedback
-            DBG("!!! WARNING: sample out of range, silencing !!!");
-            silence = true;
-        } else if (x < -1.0f) {
-            if (firstWarning) {
-                DBG("!!! WARNING: sample out of range, clamping !!!");
-                firstWarning = false;
-            }
-            buffer[i] = -1.0f;
-        } else if (x > 1.0f) {
-            if (firstWarning) {
-                DBG("!!! WARNING: sample out of range, clamping !!!");
-                firstWarning = false;
-            }
-            buffer[i] = 1.0f;
-        }
-        if (silence) {
-            memset(buffer, 0, sampleCount * sizeof(float));
-            return;
-        }
-    }
+    #ifdef ENABLE_INSTRUMENTATION
+    BlockStats& blockStats = synth.stats;
+    blockStats.voiceCount = synth.activeVoiceCount();
+    blockStats.totalTime = Instrumentation::microsecondsSince(blockStart);
+    blockStats.budgetUsed = blockStats.totalTime * 1e-6 * sampleRate / std::max(blockStats.sampleCount, 1);
+    instrumentation.push(blockStats);
+    #endif
 }
 
-void SynthAudioProcessor::render(juce::AudioBuffer<float>& buffer, int sampleCount, int bufferOffset)
+void SynthAudioProcessor::renderSlice(const juce::MidiBuffer& midiMessages, int blockLength,
+                                      int sliceStart, float* const* outputs, int sliceLength)
 {
-    float* outputBufferLeft = buffer.getWritePointer(0) + bufferOffset;
-    float* outputBufferRight = nullptr;
-    if (getTotalNumOutputChannels() > 1) {
-        outputBufferRight = buffer.getWritePointer(1) + bufferOffset;
-    }
-
-    for (int sample = 0; sample < sampleCount; ++sample) {
-        double output = 0.0;
+    int bufferOffset = 0;
 
-        if (activeNote > 0 || env > 0.0f) {
-            output += processSample();
+    // First put the events that fall inside this slice of the block into
+    // the timeline. Messages longer than three bytes, such as SysEx, are not
+    // used by the synth and are skipped here. Events that fall on the same
+    // grid position end up next to each other and are handled without
+    // rendering anything in between.
+    for (const auto metadata : midiMessages) {
+        if (metadata.numBytes > 3) {
+            continue;
+        }
 
-            #ifdef ENABLE_ENVELOPE
-            env += envSlope;
-            if (env >= 1.0f) {
-                env = 1.0f;
-            } else if (env <= 0.0f) {
-                env = 0.0f;
-            }
-            output *= env;
-            #endif
+        int position = std::clamp(metadata.samplePosition, 0, std::max(blockLength - 1, 0));
+        position -= position % eventGrid;
+        position -= sliceStart;
+        if (position < 0 || position >= sliceLength) {
+            continue;
         }
 
-        outputBufferLeft[sample] = static_cast<float>(output);
-        if (outputBufferRight != nullptr) {
-            outputBufferRight[sample] = static_cast<float>(output);
+        // The timeline never allocates. If the host sends more events than
+        // fit, render up to the last one and start over.
+        if (events.size() == events.capacity()) {
+            const int end = events.back().position;
+            renderEvents(outputs, bufferOffset, end);
+            bufferOffset = end;
         }
+
+        MidiEvent event;
+        event.position = std::max(position, bufferOffset);
+        event.data[0] = metadata.data[0];
+        event.data[1] = (metadata.numBytes >= 2) ? metadata.data[1] : 0;
+        event.data[2] = (metadata.numBytes == 3) ? metadata.data[2] : 0;
+        events.push_back(event);
     }
 
-    protectYourEars(outputBufferLeft, sampleCount);
-    protectYourEars(outputBufferRight, sampleCount);
+    renderEvents(outputs, bufferOffset, sliceLength);
 }
 
-void SynthAudioProcessor::noteOn(int note, int velocity)
+void SynthAudioProcessor::renderEvents(float* const* outputs, int start, int end)
 {
-    activeNote = note;
-    amplitude = (velocity / 127.0) * 0.5;
-    frequency = 440.0 * std::exp2(double(activeNote - 69) / 12.0);
-
-    const float attackTime = 0.01;
-    envSlope = 1.0 / (sampleRate * attackTime);
-
-    startSound();
-}
+    float* channels[Synth::maxChannels];
+    for (int channel = 0; channel < synth.outputChannelCount(); ++channel) {
+        channels[channel] = outputs[channel] + start;
+    }
+    for (auto& event : events) {
+        event.position -= start;
+    }
 
-void SynthAudioProcessor::noteOff(int note)
-{
-    if (activeNote == note) {
-        activeNote = 0;
+    synth.render(channels, end - start, events.data(), int(events.size()));
+    events.clear();
 
-        const float releaseTime = 0.01;
-        envSlope = -1.0 / (sampleRate * releaseTime);
-    }
+    checkOutput(synth.lastLimiterResult());
 }
 
 bool SynthAudioProcessor::hasEditor() const
@@ -248,9 +306,13 @@ bool SynthAudioProcessor::hasEditor() const
 
 juce::AudioProcessorEditor* SynthAudioProcessor::createEditor()
 {
+    #ifdef ENABLE_INSTRUMENTATION
+    return new InstrumentationEditor(*this);
+    #else
     auto editor = new juce::GenericAudioProcessorEditor(*this);
     editor->setSize(500, 500);
     return editor;
+    #endif
 }
 
 void SynthAudioProcessor::getStateInformation(juce::MemoryBlock& destData)
@@ -279,38 +341,198 @@ juce::AudioProcessorValueTreeState::ParameterLayout SynthAudioProcessor::createP
     // in updateParameters(). Any parameters will automatically get added
     // to the plug-in's user interface.
 
+    layout.add(std::make_unique<juce::AudioParameterChoice>(
+        juce::ParameterID("oscillator", 1),
+        "Oscillator",
+        juce::StringArray { "Sine", "Sine (Wavetable)", "Saw", "Square", "Triangle",
+                            "White Noise", "LFSR Noise", "Filtered Noise", "Explosion",
+                            "Sine (Quadrature)" },
+        0));
+
+    // Moving MIDI events onto a coarser grid makes the render segments
+    // longer, at the cost of less precise timing.
+    layout.add(std::make_unique<juce::AudioParameterChoice>(
+        juce::ParameterID("timing", 1),
+        "Event Timing",
+        juce::StringArray { "Sample Accurate", "16 Samples", "32 Samples", "64 Samples" },
+        0));
+
+    // Rendering the voices at a higher sample rate and filtering the result
+    // gets rid of most of the aliasing. It also costs 2 or 4 times as much.
+    layout.add(std::make_unique<juce::AudioParameterChoice>(
+        juce::ParameterID("oversampling", 1),
+        "Oversampling",
+        juce::StringArray { "Off", "2x", "4x" },
+        0));
+
+    layout.add(std::make_unique<juce::AudioParameterFloat>(
+        juce::ParameterID("spread", 1),
+        "Stereo Spread",
+        0.0f, 1.0f, 0.0f));
+
+    // When every voice is busy, a new note takes over the voice that has
+    // been fading out the longest, the oldest note, or the quietest voice.
+    layout.add(std::make_unique<juce::AudioParameterChoice>(
+        juce::ParameterID("stealing", 1),
+        "Voice Stealing",
+        juce::StringArray { "Released First", "Oldest", "Quietest" },
+        0));
+
+    // The range of the pitch bend wheel in semitones. With MPE turned on,
+    // every note gets its own MIDI channel and can be bent by 48 semitones,
+    // plus this range on the master channel.
+    layout.add(std::make_unique<juce::AudioParameterFloat>(
+        juce::ParameterID("bendRange", 1),
+        "Pitch Bend Range",
+        juce::NormalisableRange<float>(0.0f, 48.0f, 1.0f),
+        2.0f));
+
+    layout.add(std::make_unique<juce::AudioParameterBool>(
+        juce::ParameterID("mpe", 1),
+        "MPE",
+        false));
+
+    // The LFO is routed to the pitch (vibrato, faded in by the mod wheel),
+    // the amplitude (tremolo), and the cutoff of the filtered noise, in
+    // octaves. Routes with an amount of zero cost nothing.
+    layout.add(std::make_unique<juce::AudioParameterFloat>(
+        juce::ParameterID("lfoRate", 1),
+        "LFO Rate",
+        juce::NormalisableRange<float>(0.05f, 20.0f, 0.0f, 0.5f),
+        5.0f));
+
+    layout.add(std::make_unique<juce::AudioParameterChoice>(
+        juce::ParameterID("lfoShape", 1),
+        "LFO Shape",
+        juce::StringArray { "Sine", "Triangle", "Saw", "Square" },
+        0));
+
+    layout.add(std::make_unique<juce::AudioParameterFloat>(
+        juce::ParameterID("vibrato", 1),
+        "Vibrato",
+        0.0f, 2.0f, 0.0f));
+
+    layout.add(std::make_unique<juce::AudioParameterFloat>(
+        juce::ParameterID("tremolo", 1),
+        "Tremolo",
+        0.0f, 1.0f, 0.0f));
+
+    layout.add(std::make_unique<juce::AudioParameterFloat>(
+        juce::ParameterID("lfoCutoff", 1),
+        "LFO to Cutoff",
+        0.0f, 4.0f, 0.0f));
+
+    // How often the modulation is updated. Fewer updates use less CPU.
+    layout.add(std::make_unique<juce::AudioParameterChoice>(
+        juce::ParameterID("modRate", 1),
+        "Modulation Rate",
+        juce::StringArray { "16 Samples", "32 Samples", "64 Samples", "128 Samples" },
+        1));
+
+    layout.add(std::make_unique<juce::AudioParameterFloat>(
+        juce::ParameterID("level", 1),
+        "Output Level",
+        -48.0f, 6.0f, 0.0f));
+
+    // To avoid clicks and pops when playing notes, and to shape the sound,
+    // every voice has an ADSR envelope. Turn it off to make notes start and
+    // stop instantly. The envelope times are in milliseconds.
+    layout.add(std::make_unique<juce::AudioParameterBool>(
+        juce::ParameterID("envelope", 1),
+        "Envelope",
+        true));
+
+    layout.add(std::make_unique<juce::AudioParameterFloat>(
+        juce::ParameterID("attack", 1),
+        "Attack",
+        juce::NormalisableRange<float>(0.0f, 5000.0f, 0.0f, 0.3f),
+        10.0f));
+
+    layout.add(std::make_unique<juce::AudioParameterFloat>(
+        juce::ParameterID("decay", 1),
+        "Decay",
+        juce::NormalisableRange<float>(0.0f, 5000.0f, 0.0f, 0.3f),
+        100.0f));
+
+    layout.add(std::make_unique<juce::AudioParameterFloat>(
+        juce::ParameterID("sustain", 1),
+        "Sustain",
+        0.0f, 1.0f, 1.0f));
+
+    layout.add(std::make_unique<juce::AudioParameterFloat>(
+        juce::ParameterID("release", 1),
+        "Release",
+        juce::NormalisableRange<float>(0.0f, 5000.0f, 0.0f, 0.3f),
+        10.0f));
+
+    layout.add(std::make_unique<juce::AudioParameterChoice>(
+        juce::ParameterID("envShape", 1),
+        "Envelope Shape",
+        juce::StringArray { "Linear", "Exponential" },
+        0));
+
     return layout;
 }
 
-//==============================================================================
-// Implement the following methods to perform the sound synthesis algorithm
 //==============================================================================
 
 void SynthAudioProcessor::reset()
 {
-    phase = 0.0;
-    inc = 0.0;
+    synth.reset();
 }
 
 void SynthAudioProcessor::updateParameters()
 {
-    // Perform any necessary calculations here if the synthesis algorithm has
-    // additional parameters that can change while the sound is playing.
-}
-
-void SynthAudioProcessor::startSound()
-{
-    inc = frequency * TWO_PI / sampleRate;
-}
+    // The host and the editor change the parameters from other threads. The
+    // values are atomics, so reading them here never blocks. The synth turns
+    // any change to the output level into a ramp.
+
+    settings.oscillator = oscillatorParam->getIndex();
+
+    const int grids[] = { 1, 16, 32, 64 };
+    eventGrid = grids[timingParam->getIndex()];
+
+    const int factors[] = { 1, 2, 4 };
+    settings.oversampling = factors[oversamplingParam->getIndex()];
+
+    settings.stereoSpread = spreadParam->load();
+    settings.voiceStealing = static_cast<VoiceStealing>(stealingParam->getIndex());
+    settings.pitchBendRange = bendRangeParam->load();
+    settings.mpe = mpeParam->get();
+
+    ModulationSettings& modulation = settings.modulation;
+    modulation.lfo[0].rate = lfoRateParam->load();
+    modulation.lfo[0].shape = static_cast<LFOShape>(lfoShapeParam->getIndex());
+    const int ticks[] = { 16, 32, 64, 128 };
+    modulation.tickLength = ticks[modRateParam->getIndex()];
+    modulation.routeCount = 0;
+    auto addRoute = [&](ModSource source, ModSource via, ModDestination destination, float amount) {
+        ModRoute& route = modulation.routes[modulation.routeCount++];
+        route.source = source;
+        route.via = via;
+        route.destination = destination;
+        route.amount = amount;
+    };
+    addRoute(ModSource::lfo1, ModSource::modWheel, ModDestination::pitch, vibratoParam->load());
+    addRoute(ModSource::lfo1, ModSource::none, ModDestination::amplitude, 0.5f * tremoloParam->load());
+
+    // Only filtered noise has a cutoff. For the other oscillators the route
+    // would make the synth tick the modulation for nothing.
+    const float lfoCutoff = lfoCutoffParam->load();
+    if (settings.oscillator == 7 && lfoCutoff != 0.0f) {
+        addRoute(ModSource::lfo1, ModSource::none, ModDestination::cutoff, lfoCutoff);
+    }
 
-double SynthAudioProcessor::processSample()
-{
-    double output = amplitude * std::sin(phase);
+    settings.outputLevel = decibelsToGain(levelParam->load());
 
-    phase += inc;
-    if (phase > TWO_PI) {
-        phase -= TWO_PI;
-    }
+    settings.useEnvelope = envelopeParam->get();
+    settings.envelope.attack = attackParam->load() * 0.001;
+    settings.envelope.decay = decayParam->load() * 0.001;
+    settings.envelope.sustain = sustainParam->load();
+    settings.envelope.release = releaseParam->load() * 0.001;
+    settings.envelope.shape = static_cast<EnvelopeShape>(envShapeParam->getIndex());
 
-    return output;
+    // The oscillator, the envelope and the number of channels choose which
+    // of the synth's voice kernels renders the block.
+    synth.setSettings(settings);
 }
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "InstrumentationEditor.h"
+#include "../../dsp/Instrumentation.h"
+#include "../../dsp/Synth.h"
 
 class SynthAudioProcessor : public juce::AudioProcessor
 {
@@ -15,6 +18,8 @@ public:
     bool isBusesLayoutSupported(const BusesLayout& layouts) const override;
 
     void processBlock(juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlock(juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+    bool supportsDoublePrecisionProcessing() const override;
 
     juce::AudioProcessorEditor* createEditor() override;
     bool hasEditor() const override;
@@ -37,33 +42,61 @@ public:
 
     juce::AudioProcessorValueTreeState apvts { *this, nullptr, "Parameters", createParameterLayout() };
 
+    #ifdef ENABLE_INSTRUMENTATION
+    Instrumentation instrumentation;
+    #endif
+
 private:
     juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
 
-    void splitBufferByEvents(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages);
-    void handleMIDI(uint8_t data0, uint8_t data1, uint8_t data2);
-    void render(juce::AudioBuffer<float>& buffer, int sampleCount, int bufferOffset);
+    template<typename SampleType>
+    void processBuffer(juce::AudioBuffer<SampleType>& buffer, juce::MidiBuffer& midiMessages);
 
-    void noteOn(int note, int velocity);
-    void noteOff(int note);
+    void renderSlice(const juce::MidiBuffer& midiMessages, int blockLength,
+                     int sliceStart, float* const* outputs, int sliceLength);
+    void renderEvents(float* const* outputs, int start, int end);
 
     void updateParameters();
-    void startSound();
-    double processSample();
+
+    juce::AudioParameterChoice* oscillatorParam;
+    juce::AudioParameterChoice* timingParam;
+    std::atomic<float>* levelParam;
+    std::atomic<float>* attackParam;
+    std::atomic<float>* decayParam;
+    std::atomic<float>* sustainParam;
+    std::atomic<float>* releaseParam;
+    juce::AudioParameterBool* envelopeParam;
+    juce::AudioParameterChoice* envShapeParam;
+    juce::AudioParameterChoice* oversamplingParam;
+    std::atomic<float>* spreadParam;
+    juce::AudioParameterChoice* stealingParam;
+    std::atomic<float>* bendRangeParam;
+    juce::AudioParameterBool* mpeParam;
+    std::atomic<float>* lfoRateParam;
+    juce::AudioParameterChoice* lfoShapeParam;
+    std::atomic<float>* vibratoParam;
+    std::atomic<float>* tremoloParam;
+    std::atomic<float>* lfoCutoffParam;
+    juce::AudioParameterChoice* modRateParam;
 
     double sampleRate;
-    int activeNote;
-    double frequency;
-    double amplitude;
-    double env;
-    double envSlope;
+
+    // The MIDI events for the current block, sorted by sample position and
+    // moved onto a grid of `eventGrid` samples.
+    std::vector<MidiEvent> events;
+    int eventGrid = 1;
 
     //==============================================================================
-    // Declare the variables for the synthesis algorithm here
+    // Everything that makes the sound lives in the Synth object, which is
+    // shared with the command line tool.
     //==============================================================================
 
-    double phase;
-    double inc;
+    Synth synth;
+    SynthSettings settings;
+
+    // For double precision, the synth renders into this first.
+    std::vector<float> mixBuffer;
+    int mixBufferSize = 0;
 
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SynthAudioProcessor)